@@ -3,7 +3,15 @@
 import sys
 import numpy as np
 
-def readOutputFile1(ofname):
+# ./main -o f64|f32 writes raw values, n per b; the first b is compared
+BINARY = {".f64": "<f8", ".f32": "<f4"}
+
+def readOutputFile1(ofname, n):
+    ext = ofname[ofname.rfind("."):]
+    if ext in BINARY:
+        x = np.fromfile(ofname, dtype=BINARY[ext], count=n).astype(float)
+        return zip([x], [1])
+
     with open(ofname) as f:
         content = [x.strip() for x in f.readlines()]
 
@@ -29,7 +37,7 @@ if __name__ == "__main__":
     x = readOutputFile(afname)
 
     x -= np.min(x)
-    for x_hat, y in readOutputFile1(ofname):
+    for x_hat, y in readOutputFile1(ofname, len(x)):
         x_hat -= np.min(x_hat)
 
         diff = np.absolute(x - x_hat)
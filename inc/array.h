@@ -0,0 +1,38 @@
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Allocator whose resize(m) leaves the new elements uninitialized. The pages
+// of a large array are then first written, and with first-touch placed on
+// the NUMA node of, the thread that fills them instead of the one that
+// allocated it.
+template <typename T>
+struct UninitAllocator: std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        typedef UninitAllocator<U> other;
+    };
+
+    UninitAllocator() {}
+    template <typename U>
+    UninitAllocator(const UninitAllocator<U>&) {}
+
+    template <typename U>
+    void construct(U *p) {
+        ::new ((void *) p) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U *p, Args&&... args) {
+        ::new ((void *) p) U(std::forward<Args>(args)...);
+    }
+};
+
+// an array of one entry per vertex or arc, filled by the threads using it
+template <typename T>
+using Array = std::vector<T, UninitAllocator<T> >;
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+
+// Checkpoint of a prepared Lsolver (Lsolver::save), all fields in native
+// byte order:
+//
+//   CheckpointHeader
+//   long    offsets[n + 1]
+//   int     targets[narcs]
+//   double  weights[narcs]
+//   ...     the arrays of the slots of the alias tables, narcs entries each
+//   int     order[norder]        the renumbering, norder being 0 or n
+//   double  eta[nstate]          the state of the last solve, nstate being 0
+//   int     Q[nstate]            when nothing was solved yet
+//   Rng     rng[nstreams]        the random streams of the threads
+//   RngLanes lanes[nstreams]
+//
+// every array padded to a multiple of 8 bytes, so that all of them are
+// aligned in the mapped file.
+struct CheckpointHeader {
+    char magic[8];
+    long n;
+    long narcs;
+    // Graph::getHash in the input numbering, i.e. through order
+    uint64_t graphHash;
+    // bytes per arc of the slots, which tells the samplers apart
+    long slotBytes;
+    long norder;
+    long nstate;
+    long nstreams;
+    long sink;
+    double beta;
+};
+
+extern const char CHECKPOINT_MAGIC[8];
+
+#endif
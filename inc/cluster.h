@@ -0,0 +1,41 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include "partition.h"
+
+#include <vector>
+
+// The processes of an MPI run (make mpi=1). Without USE_MPI this is a single
+// process and every reduction returns its argument, so the solver runs the
+// same code either way.
+//
+// Every rank keeps the arcs leaving its own block of getPartition(n) only; the
+// sink, vertex n - 1, is owned by the last rank. Calls are made from one
+// thread at a time, but for a single rank, which calls MPI in init and
+// finalize only.
+class Cluster {
+public:
+    static void init(int *argc, char ***argv);
+    static void finalize();
+
+    static int getRank();
+    static int getNumRanks();
+
+    static Partition getPartition(int n) {
+        return Partition(0, n, getNumRanks());
+    }
+
+    static long sum(long x);
+    static double sum(double x);
+    static double max(double x);
+
+    // element-wise sum over the ranks, in place
+    static void sum(std::vector<double>& x);
+
+    // Sends out[r] to rank r and returns everything received, rank by rank,
+    // in in; out is cleared.
+    static void exchange(std::vector< std::vector<int> >& out,
+            std::vector<int>& in);
+};
+
+#endif
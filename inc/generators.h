@@ -0,0 +1,25 @@
+#ifndef GENERATORS_H
+#define GENERATORS_H
+
+#include "rng.h"
+#include "graph.h"
+
+#include <vector>
+
+// Synthetic connected inputs, generated in process for benchmarking. Edge
+// weights are uniform in [0.1, 1).
+
+// random spanning tree plus uniformly random edges up to an average degree
+Graph randomGraph(int n, double avgDegree, Rng& rng);
+
+// side x side grid, vertices numbered row by row
+Graph gridGraph(int side, Rng& rng);
+
+// preferential attachment (Barabasi-Albert): every new vertex links to m
+// existing ones picked with probability proportional to their degree
+Graph powerLawGraph(int n, int m, Rng& rng);
+
+// nsources random sources of 1, all sunk at the last vertex
+std::vector<double> oneSinkRhs(int n, int nsources, Rng& rng);
+
+#endif
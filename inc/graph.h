@@ -2,8 +2,12 @@
 #define GRAPH_H
 
 #include <vector>
+#include <cstdint>
 #include <iostream>
 
+// Undirected weighted graph in compressed sparse row (CSR) form. Every edge
+// is stored as two arcs; the arcs leaving u are [getOffsets()[u],
+// getOffsets()[u + 1]) in getTargets() and getWeights().
 class Graph {
 public:
     Graph() {}
@@ -20,30 +24,90 @@ public:
         return n;
     }
 
+    long getNumArcs() const {
+        return offset.empty() ? 0 : offset[n];
+    }
+
+    void reserve(long m) {
+        edges.reserve(m);
+    }
+
+    // edges are buffered until finalize() packs them into the CSR arrays
     void addEdge(int u, int v, double w) {
         deg[u] += w;
-        adj[u].push_back({v, w});
-
         deg[v] += w;
-        adj[v].push_back({u, w});
+        edges.push_back({u, v, w});
     }
 
-    const std::vector< std::pair<int, double> >& getNeighbors(int u) const {
-        return adj[u];
+    void finalize();
+
+    // adopts ready CSR arrays, e.g. read from a binary file
+    void setCsr(int _n, std::vector<long> _offset, std::vector<int> _target,
+            std::vector<double> _weight);
+
+    // drops the arcs leaving the vertices outside [first, last), e.g. those
+    // owned by other ranks; the degrees of all the vertices are kept
+    void keepRows(int first, int last);
+
+    // renumbers the vertices, order[i] becoming vertex i
+    void permute(const std::vector<int>& order);
+
+    // Sets the weight of the edge uv to w in place, the degrees of u and v
+    // following; parallel arcs are set to 0. False when there is no such
+    // edge, which then has to be added.
+    bool setWeight(int u, int v, double w);
+
+    int getDegree(int u) const {
+        return (int) (offset[u + 1] - offset[u]);
+    }
+
+    const std::vector<long>& getOffsets() const {
+        return offset;
+    }
+
+    const std::vector<int>& getTargets() const {
+        return target;
+    }
+
+    const std::vector<double>& getWeights() const {
+        return weight;
     }
 
     const std::vector<double>& getDegreeMatrix() const {
         return deg;
     }
+
+    // Hash of the CSR arrays as numbered before permute(order), i.e. of the
+    // graph that was read when order is that of the solver; it tells a
+    // checkpoint for another graph of the same size apart.
+    uint64_t getHash(const std::vector<int>& order = {}) const;
+
+    // Labels every vertex with the smallest vertex of its connected component
+    // and returns the number of components. Runs a lock-free parallel
+    // union-find over the edges, so it needs no recursion or stack; edges
+    // of weight 0, e.g. removed by setWeight, do not connect.
+    int getComponents(std::vector<int>& label) const;
 private:
-    int n;
+    struct Edge {
+        int u;
+        int v;
+        double w;
+    };
+
+    int n = 0;
 
     std::vector<double> deg;
-    std::vector< std::vector< std::pair<int, double> > > adj;
+
+    std::vector<long> offset;
+    std::vector<int> target;
+    std::vector<double> weight;
+
+    std::vector<Edge> edges;
 
     void init() {
-        deg.resize(n, 0);
-        adj.resize(n);
+        deg.assign(n, 0);
+        offset.assign(n + 1, 0);
+        target.clear(), weight.clear(), edges.clear();
     }
 };
 
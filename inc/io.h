@@ -0,0 +1,70 @@
+#ifndef IO_H
+#define IO_H
+
+#include "graph.h"
+#include "partition.h"
+
+#include <cstddef>
+#include <vector>
+
+// Binary CSR format, all fields in native (little-endian) byte order:
+//
+//   BinaryHeader
+//   long   offsets[n + 1]
+//   int    targets[narcs]    padded to a multiple of 8 bytes
+//   double weights[narcs]
+//   double b[nrhs][n]
+//
+// so that every array is 8 byte aligned in the mapped file.
+struct BinaryHeader {
+    char magic[8];
+    long n;
+    long narcs;
+    long nrhs;
+};
+
+extern const char BINARY_MAGIC[8];
+
+// Reads an .inp text file or a binary file, told apart by the magic at the
+// start of the file. Both are mapped into memory; the text is parsed with
+// std::from_chars, the binary arrays are copied straight into the graph
+// once the offsets and the arcs copied have been checked. A corrupt file
+// exits with a message.
+//
+// With nparts > 1 only the arcs leaving the vertices of block part of
+// Partition(0, n, nparts) are kept. The binary reader then copies just those
+// rows, so a graph can be split over hosts that could not hold it whole; text
+// input is parsed in full first.
+void readInput(const char *fname, Graph& g,
+        std::vector< std::vector<double> >& bs, int part = 0, int nparts = 1);
+
+void writeBinary(const char *fname, const Graph& g,
+        const std::vector< std::vector<double> >& bs);
+
+enum OutputFormat {
+    TEXT,
+    DOUBLE,
+    FLOAT
+};
+
+// Writes the solutions one after the other to fname, "-" being stdout. TEXT
+// writes a line per solution, each value in the fewest digits that read back
+// to the same double. DOUBLE and FLOAT write the raw native values, n per
+// solution and nothing else. Either is written in chunks of a buffer.
+void writeSolutions(const char *fname,
+        const std::vector< std::vector<double> >& xs, OutputFormat format);
+
+// read-only private mapping of a whole file; exits when it cannot be mapped
+class MappedFile {
+public:
+    MappedFile(const char *fname);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char *data = nullptr;
+    size_t size = 0;
+};
+
+#endif
@@ -1,61 +1,428 @@
 #ifndef LSOLVER_H
 #define LSOLVER_H
 
+#include "rng.h"
 #include "graph.h"
 #include "sampler.h"
+#include "exchange.h"
+#include "workspace.h"
+#include "monitor.h"
+#include "cluster.h"
+#include "metrics.h"
 
+#include <tuple>
+#include <atomic>
+#include <iosfwd>
+#include <memory>
 #include <vector>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <functional>
 
 class Lsolver {
 public:
-    Lsolver(const Graph& g) {
-        initGraph(g);
+    // a node marks the hops of a time step in the bits of one word
+    static const int MAX_K = 64;
+
+    // setWalkLength(AUTO_K) picks K from the degrees at every solve
+    static const int AUTO_K = 0;
+
+    // How the nodes are dealt to the threads in the time steps of the
+    // kernels. STATIC gives every thread an equal block. DYNAMIC hands out
+    // small chunks on demand. BALANCED cuts the blocks anew at the start of
+    // every epoch so that they cost the same, a node costing more the longer
+    // its queue. A node draws from the stream of the thread it falls to, so
+    // DYNAMIC runs are not reproducible.
+    enum Schedule {
+        STATIC,
+        DYNAMIC,
+        BALANCED
+    };
+
+    // How the threads are bound to the CPUs the process may run on, along
+    // Topology::getOrder(). NONE leaves them to the OS; COMPACT fills one
+    // socket before the next and SPREAD deals the threads out over the
+    // sockets in turn.
+    enum Pinning {
+        NONE,
+        COMPACT,
+        SPREAD
+    };
+
+    // called with begin true and false around every phase of a solve
+    // ("search", "epoch", "sample", "computeX", "refine"), e.g. to read
+    // hardware counters
+    typedef std::function<void(const char *phase, bool begin)> PhaseHook;
+
+    // called by solve_becchetti after every epoch with the estimate of x,
+    // the relative change e of the queues over the epoch and the seconds
+    // since the start; returning false stops the solve
+    typedef std::function<bool(const std::vector<double>& x, double e,
+            double seconds)> Progress;
+
+    // the solver keeps its own graph; move it in to avoid the copy
+    Lsolver(Graph _g): g(std::move(_g)) {
+        initGraph();
     }
 
-    Lsolver(const Graph& g, const std::vector<double>& b) {
-        initGraph(g);
-        computeJ(b);
+    Lsolver(Graph _g, const std::vector<double>& b): g(std::move(_g)),
+            rhs(b) {
+        initGraph();
     }
 
+    // Restores a solver written by save(): the graph and its alias tables,
+    // without preparing them again, and the beta, queues and random streams
+    // of the last solve. A solve of the same sink then re-mixes from there,
+    // as after updateEdge, instead of searching for beta, and goes on with
+    // the saved streams when run on as many threads. Single process only.
+    explicit Lsolver(const char *checkpoint);
+
+    // writes the solver to fname in the format of inc/checkpoint.h; of the
+    // state of the solves, only the queues and beta of the last sink are
+    // kept, so a multi-sink b or a batch only resumes for that sink
+    void save(const char *fname) const;
+
+    // the sampler points into the arrays of g
+    Lsolver(const Lsolver&) = delete;
+    Lsolver& operator=(const Lsolver&) = delete;
+
+    // Renumbers the vertices in reverse Cuthill-McKee order so that the walks
+    // and the omp for chunks touch nearby memory; b and x keep the original
+    // numbering. The next solve searches for beta afresh. Single process
+    // only.
+    void reorder();
+
+    // Any b summing to zero: the nodes with b_u < -1e-6 are the sinks. With
+    // one sink it is simulated as is; otherwise b is split into one one-sink
+    // system per sink s, taking the share -b_s/sum(b_u > 0) of every source,
+    // and their solutions are added up. All of them reuse the prepared graph.
     std::vector<double> solve();
     std::vector<double> solve(const std::vector<double>& b) {
-        computeJ(b);
+        rhs = b;
         return solve();
     }
 
-    std::vector<double> solve_becchetti();
+    // Solves Lx = b for every b in bs on the same prepared graph. Besides the
+    // samplers and the thread team, each search for beta starts from the
+    // beta of the previous right-hand side instead of from scratch.
+    std::vector< std::vector<double> > solveBatch(
+            const std::vector< std::vector<double> >& bs);
+
+    // Sets the weight of the edge uv (input numbering) to w, 0 removing it;
+    // removing an edge that does not exist does nothing. The weights and
+    // alias tables of u and v are updated in place; a new edge rebuilds them
+    // all. The next solve of the same sink then re-mixes
+    // the DCP from the queues and beta of the last one and skips the search
+    // for beta if that beta is still admissible. Single process only.
+    // Exits when removing the edge would disconnect the graph.
+    void updateEdge(int u, int v, double w);
+
+    // Anytime solve by becchetti's, for the one-sink b given to the
+    // constructor, single process only. Runs epochs until seconds have
+    // passed, the relative change of the queues over an epoch is below
+    // errTol or progress returns false, and returns the last x.
+    std::vector<double> solve_becchetti(double seconds = 60,
+            double errTol = 0, Progress progress = nullptr);
+
+    // a Progress printing the seconds and then x of every epoch, on a line
+    // each
+    static Progress printProgress(std::ostream& out);
+
+    // all the threads derive their streams from this seed, so a run is
+    // reproducible for a fixed seed and number of threads, unless the
+    // schedule is DYNAMIC
+    void setSeed(uint64_t _seed) {
+        seed = _seed;
+    }
+
+    // 0 uses the OpenMP default, i.e. OMP_NUM_THREADS when it is set
+    void setNumThreads(int _nthreads) {
+        nthreads = _nthreads;
+    }
+
+    int getNumThreads() const;
+
+    int getNumVertex() const {
+        return n;
+    }
+
+    long getNumArcs() const {
+        return g.getNumArcs();
+    }
+
+    // Graph::getHash of the graph in the input numbering, to be compared
+    // with that of the input a checkpoint is loaded for
+    uint64_t getGraphHash() const {
+        return g.getHash(order);
+    }
+
+    bool isReordered() const {
+        return not order.empty();
+    }
+
+    // number of time steps per epoch while the DCP is mixing; decrease this
+    // for becchetti's
+    void setEpochLength(int _epochLength) {
+        epochLength = _epochLength;
+    }
+
+    // once mixed, the DCP is sampled in batches of this many steps until the
+    // 95% confidence interval on eta is within tol (relative, 2-norm)
+    void setBatchLength(int _batchLength) {
+        batchLength = _batchLength;
+    }
+
+    void setTolerance(double _tol) {
+        tol = _tol;
+    }
+
+    void setSchedule(Schedule _schedule) {
+        schedule = _schedule;
+    }
+
+    // pins the threads at the start of every solve
+    void setPinning(Pinning _pinning) {
+        pinning = _pinning;
+    }
+
+    // With pinned threads on more than one socket, the walks of each socket
+    // read a copy of the alias tables and CSR targets of their own, written
+    // there at the start of every solve. Costs that memory once per socket.
+    void setReplicas(bool _replicas) {
+        replicas = _replicas;
+    }
+
+    // Fuses the two barriers of a time step into one: the packets of a step
+    // are queued by their owners at the start of the next, while the others
+    // send to a second buffer. The DCP simulated is the same. The threads
+    // keep equal blocks whatever the schedule, and pll_v2 holds two words
+    // of marks per node.
+    void setFusedSteps(bool _fused) {
+        fused = _fused;
+    }
+
+    // Hops a packet makes per time step of pll_v2 and becchetti_v2. The
+    // kernels are compiled for K = 8, 16, 32 and 64, marking a node in a
+    // word of K bits; other values run on the next wider word.
+    void setWalkLength(int _K) {
+        assert(0 <= _K and _K <= MAX_K);
+        autoK = (_K == AUTO_K);
+        if (not autoK) K = _K;
+    }
+
+    // Preset K for the degrees of the graph: few hops on dense graphs,
+    // whose walks mix within a few of them, and the most on sparse ones
+    // with hubs. See results/k_comp.csv.
+    int autoWalkLength() const;
+
+    int getWalkLength() const {
+        return K;
+    }
+
+    // bisection steps of the beta bracket; each halves its log width
+    void setBetaSteps(int _betaSteps) {
+        betaSteps = _betaSteps;
+    }
+
+    // Mixes this many beta candidates at once in every round of the search,
+    // each on its own queues and counts and getNumThreads()/R threads, over
+    // the tables of the solver. The largest admissible one of a round is
+    // kept, and the next round aims past it at the occupancies the search
+    // stops at.
+    // 1, the default, searches one candidate at a time. Single process and
+    // CPU only; otherwise the search is serial.
+    void setBetaReplicas(int _betaReplicas) {
+        assert(_betaReplicas >= 1);
+        betaReplicas = _betaReplicas;
+    }
+
+    // Samples eta as the mean of this many independent DCPs, which go on
+    // from the mixed queues at the chosen beta with getNumThreads()/R
+    // threads and streams of their own each, until their interval is
+    // sqrt(R) times tol. 1, the default, samples the DCP of the search
+    // itself. Single process and CPU only; otherwise there is one.
+    void setEtaReplicas(int _etaReplicas) {
+        assert(_etaReplicas >= 1);
+        etaReplicas = _etaReplicas;
+    }
+
+    // Refines the x of the walks with Jacobi preconditioned CG until the
+    // residual is below tol relative to b; 0 (the default) skips it
+    void setRefineTolerance(double _refineTol) {
+        refineTol = _refineTol;
+    }
+
+    void setPhaseHook(PhaseHook _hook) {
+        hook = _hook;
+    }
+
+    // CG iterations spent refining by the last solve
+    long getNumIterations() const {
+        return metrics.iterations;
+    }
+
+    // time steps simulated by the last solve, over all beta candidates
+    long getNumSteps() const {
+        return metrics.steps;
+    }
+
+    double getBeta() const {
+        return beta;
+    }
+
+    // Standard error of every entry of the last x solved for, in the
+    // numbering of b, from the batches of the walks behind it: those of
+    // every replica pooled, and those of every sink added up. Refining with
+    // setRefineTolerance only lowers the error.
+    const std::vector<double>& getStandardError() const {
+        return stdError;
+    }
+
+    const Metrics& getMetrics() const {
+        return metrics;
+    }
 private:
     int n;
-    int nsources;
 
-    std::vector<double> d;
-    std::vector<double> J;
-    std::vector<double> eta;
+    // the vertices [first, last) are simulated by this rank, whose graph
+    // only holds the arcs leaving them
+    int first;
+    int last;
+
+    Graph g;
+
+    // make compact=1 walks on the 8 byte slots of CompactSlots
+#ifdef COMPACT_SAMPLER
+    typedef CompactSampler WalkSampler;
+#else
+    typedef Sampler WalkSampler;
+#endif
+    WalkSampler sampler;
+
+    // the tables on every socket with pinned threads, and those every
+    // thread walks on: its replica, or sampler
+    std::vector<WalkSampler> replica;
+    std::vector<const WalkSampler *> walker;
 
-    std::vector< std::vector< std::pair<int, double> > > adj;
+    // order[i] is the input vertex simulated as i, and position its
+    // inverse; both empty when not reordered
+    std::vector<int> order;
+    std::vector<int> position;
+
+    std::vector<double> rhs;
+    Array<double> J;
+    std::vector<double> eta;
+    std::vector<double> etaError;
+    std::vector<double> stdError;
 
     double beta;
+    double betaHint = 0;
     double b_sink;
 
-    std::vector<int> Q;
-    std::vector<int> cnt;
+    // the node packets are sunk at, numbered as simulated
+    int sink;
+
+    // the queues left by the last solve, of lastSink, are to be re-mixed
+    bool resume = false;
+    int lastSink = -1;
 
-    std::vector<Sampler> sampler;
+    // the streams of rng and lanes were loaded and are not to be seeded
+    bool restored = false;
 
-    void initGraph(const Graph& g);
-    void computeJ(const std::vector<double>& b);
+    Array<int> Q;
+    Array<int> cnt;
+
+    Exchange exchange;
+    Exchange touched;
+    // the marks of pll_v2, one word per node as wide as its K needs
+    std::tuple< Array<uint8_t>, Array<uint16_t>, Array<uint32_t>,
+        Array<uint64_t> > marks;
+    ConvergenceMonitor monitor;
+    Workspace work;
+
+    int epochLength = 5000;
+    int batchLength = 500;
+    double tol = 0.05;
+    int betaSteps = 4;
+    int betaReplicas = 1;
+    int etaReplicas = 1;
+    int K = MAX_K;
+    bool autoK = false;
+    Schedule schedule = STATIC;
+    Pinning pinning = NONE;
+    bool replicas = false;
+    bool fused = false;
+
+    // first node of the block of every thread, and one past the last
+    std::vector<int> bounds;
+    std::atomic<long> chunks[2];
+
+    // walks started by every node in the last call of pll_v2
+    Array<int> load;
+    double refineTol = 0;
+
+    Metrics metrics;
+    PhaseHook hook;
+    double occupancy = 0;
+
+    int nthreads = 0;
+
+    uint64_t seed = Rng::DEFAULT_SEED;
+    std::vector<Rng> rng;
+    std::vector<RngLanes> lanes;
+    // parts of the replicas created since the threads were seeded; every set
+    // of replicas draws from the blocks of streams after them
+    long replicaParts = 0;
+
+    // a DCP of its own for the parallel search, see searchBetaParallel()
+    Lsolver(const Lsolver& parent, int part, int parts);
+
+    void initGraph();
+    void computeJ(const std::vector<double>& b, int s);
+    void seedThreads();
+    void initThreads();
+    std::vector<double> solveCurrent();
+    std::vector<double> solveRhs(const std::vector<double>& b);
+    void startSolve();
+    void finishSolve(double seconds);
 
     void computeStationarityState();
+    void searchBeta();
+    void searchBetaParallel();
+    template <typename F>
+    void forReplicas(std::vector< std::unique_ptr<Lsolver> >& dcp, int m,
+            F f);
+    void takeMetrics(Lsolver& s);
+    bool remix();
+
+    template <typename Cost>
+    void rebalance(int T, Cost cost);
+    template <typename F>
+    void forNodes(int tid, int t, F f);
+    template <typename F>
+    void hop(int tid, int i, int count, std::vector<int>& draws, F f);
 
-    void becchetti_v1();
-    void becchetti_v2();
+    void becchetti_v1(int steps);
+    void becchetti_v2(int steps);
+    template <int HOPS>
+    void becchetti_v2_k(int steps);
 
-    void serial();
-    void pll_v1();
-    void pll_v2();
-    double estimateEta(double);
+    void serial(int steps);
+    void pll_v1(int steps);
+    void pll_v2(int steps);
+    template <int HOPS, typename Word>
+    void pll_v2_k(int steps);
+    double runEpoch(int steps);
+    double mixDCP();
+    bool isAdmissible(double C) const;
+    void sampleEta();
+    void sampleBatches();
+    void sampleReplicas(int R);
 
     std::vector<double> computeX();
+    void addVariance(std::vector<double>& var) const;
+    int refine(std::vector<double>& x, const std::vector<double>& b);
 };
 
 #endif
@@ -0,0 +1,56 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <vector>
+#include <ostream>
+
+// What the last solve did and where its time went, filled by Lsolver as it
+// runs. Times are wall clock seconds; in an MPI run the counts are summed
+// over the ranks and the times and thread loads are those of the rank asked.
+struct Metrics {
+    // one per beta tried by the search
+    struct Candidate {
+        double beta;
+        int epochs;
+        double C;
+        double occupancy;
+        bool admissible;
+    };
+
+    double init = 0;
+    double search = 0;
+    double sample = 0;
+    double computeX = 0;
+    double refine = 0;
+    double total = 0;
+
+    // every epoch of pll_v2 run while mixing, over all beta candidates
+    std::vector<double> epochs;
+    std::vector<Candidate> candidates;
+
+    long steps = 0;
+    long hops = 0;
+    long sunk = 0;
+    long iterations = 0;
+
+    // sink fraction of the last epoch of the chosen beta
+    double C = 0;
+
+    // searches that found no admissible beta, eta then being sampled at the
+    // smallest candidate
+    int fallbacks = 0;
+
+    // time each thread spent walking in the omp for of pll_v2, i.e. before
+    // waiting for the others at the barrier
+    std::vector<double> busy;
+
+    // slowest over mean busy thread: 1 is a perfect balance
+    double getImbalance() const;
+
+    void print(std::ostream& out) const;
+
+    // the time, the steps and any iterations of the refinement only
+    void printSummary(std::ostream& out) const;
+};
+
+#endif
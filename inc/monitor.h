@@ -0,0 +1,58 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include "workspace.h"
+
+#include <vector>
+
+// Online batch-means estimate of the queue occupancy probabilities. Each batch
+// of the simulation contributes one sample cnt[i]/steps per node; Welford's
+// update keeps the mean and the spread of these samples, from which the
+// half width of the confidence interval on eta is derived.
+class ConvergenceMonitor {
+public:
+    // z-score of the reported confidence interval (95%)
+    static constexpr double Z = 1.96;
+
+    void reset(int _n) {
+        n = _n, nbatches = 0, nsteps = 0;
+        mean.assign(n, 0), m2.assign(n, 0);
+        halfWidth = 0;
+    }
+
+    // consumes the counts gathered over the last batch and zeroes them
+    void add(Array<int>& cnt, int steps, int nthreads);
+
+    // ||CI half width|| / ||eta||, infinite until two batches are in
+    double getRelativeHalfWidth() const {
+        return halfWidth;
+    }
+
+    int getNumBatches() const {
+        return nbatches;
+    }
+
+    long getNumSteps() const {
+        return nsteps;
+    }
+
+    const std::vector<double>& getMean() const {
+        return mean;
+    }
+
+    // standard error of the mean of every node over the batches, 0 until two
+    // batches are in
+    std::vector<double> getStandardError() const;
+
+private:
+    int n = 0;
+    int nbatches = 0;
+    long nsteps = 0;
+
+    std::vector<double> mean;
+    std::vector<double> m2;
+
+    double halfWidth = 0;
+};
+
+#endif
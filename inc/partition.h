@@ -0,0 +1,34 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+// Contiguous blocks of the vertices [begin, end) among P parts: part p owns
+// [first(p), first(p + 1)). Used both for the ranks of an MPI run and for the
+// threads of a kernel inside one rank.
+class Partition {
+public:
+    Partition() {}
+    Partition(int _begin, int _end, int _P): begin(_begin), end(_end), P(_P) {}
+
+    int first(int p) const {
+        return begin + (int) ((long) (end - begin) * p / P);
+    }
+
+    int owner(int v) const {
+        return (int) (((long) (v - begin + 1) * P - 1) / (end - begin));
+    }
+
+    bool owns(int p, int v) const {
+        return first(p) <= v and v < first(p + 1);
+    }
+
+    int getNumParts() const {
+        return P;
+    }
+
+private:
+    int begin = 0;
+    int end = 0;
+    int P = 1;
+};
+
+#endif
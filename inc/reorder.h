@@ -0,0 +1,14 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+#include "graph.h"
+
+#include <vector>
+
+// Reverse Cuthill-McKee order of the vertices: breadth first from a vertex of
+// low degree far from the others, neighbours by increasing degree, reversed.
+// Adjacent vertices get close numbers, so walks touch nearby memory. order[i]
+// is the vertex to be numbered i.
+std::vector<int> rcmOrder(const Graph& g);
+
+#endif
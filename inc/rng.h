@@ -1,21 +1,116 @@
 #ifndef RNG_H
 #define RNG_H
 
-#define MAX 18446744073709551615ULL
-
-// Source: http://www.cse.yorku.ca/~oz/marsaglia-rng.html
-static unsigned long z = 12345;
-static unsigned long w = 65435;
-static unsigned long jsr = 34221;
-static unsigned long jcong = 12345;
-
-#define znew (z=36969*(z&65535)+(z>>16))
-#define wnew (w=18000*(w&65535)+(w>>16))
-#define MWC  ((znew<<16)+wnew)
-#define CONG (jcong=69069*jcong+1234567)
-#define SHR3 (jsr^=(jsr<<17), jsr^=(jsr>>13), jsr^=(jsr<<5))
-#define KISS ((MWC^CONG)+SHR3)
-
-#define random_double ((double) KISS/MAX)
+#include <cstdint>
+
+// xoshiro256** seeded through splitmix64
+// Source: https://prng.di.unimi.it/
+//
+// Every thread owns one engine; the alignment keeps the engines of different
+// threads on different cache lines when they are stored next to each other.
+class alignas(64) Rng {
+public:
+    typedef uint64_t result_type;
+
+    static const uint64_t DEFAULT_SEED = 12345;
+
+    Rng(uint64_t seed = DEFAULT_SEED, uint64_t stream = 0) {
+        setSeed(seed, stream);
+    }
+
+    // Streams derived from the same master seed are decorrelated by hashing
+    // the stream id (usually the thread id) into the splitmix64 state.
+    void setSeed(uint64_t seed, uint64_t stream = 0) {
+        uint64_t x = seed ^ splitmix64(stream);
+        for (auto& i: s) {
+            i = splitmix64(x);
+            x += 0x9e3779b97f4a7c15ULL;
+        }
+    }
+
+    uint64_t operator()() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+
+        return result;
+    }
+
+    // uniform in [0, 1)
+    double nextDouble() {
+        return (double) ((*this)() >> 11) * 0x1.0p-53;
+    }
+
+    static constexpr uint64_t min() { return 0; }
+    static constexpr uint64_t max() { return UINT64_MAX; }
+
+private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    static uint64_t splitmix64(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+};
+
+// LANES xoshiro256** engines stepped together, word i of the state of every
+// lane next to the others, so that fill() runs in vector registers: 2 lanes
+// at a time with SSE2, 4 with AVX2 and all 8 with AVX-512. Lane l of stream t
+// starts from Rng stream t * LANES + l of the complemented seed, apart from
+// the streams of the Rng engines of the same seed.
+class alignas(64) RngLanes {
+public:
+    static const int LANES = 8;
+
+    RngLanes(uint64_t seed = Rng::DEFAULT_SEED, uint64_t stream = 0) {
+        setSeed(seed, stream);
+    }
+
+    void setSeed(uint64_t seed, uint64_t stream = 0) {
+        for (int l = 0; l < LANES; ++l) {
+            Rng r(~seed, stream * LANES + l);
+            for (auto& i: s) i[l] = r();
+        }
+    }
+
+    // the next count words of the lanes, count a multiple of LANES
+    void fill(uint64_t *out, int count) {
+        for (int i = 0; i < count; i += LANES) {
+#pragma omp simd
+            for (int l = 0; l < LANES; ++l) {
+                out[i + l] = rotl(s[1][l] * 5, 7) * 9;
+                uint64_t t = s[1][l] << 17;
+
+                s[2][l] ^= s[0][l];
+                s[3][l] ^= s[1][l];
+                s[1][l] ^= s[2][l];
+                s[0][l] ^= s[3][l];
+
+                s[2][l] ^= t;
+                s[3][l] = rotl(s[3][l], 45);
+            }
+        }
+    }
+
+private:
+    uint64_t s[4][LANES];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+};
 
 #endif
@@ -2,28 +2,199 @@
 #define SAMPLER_H
 
 #include "rng.h"
+#include "array.h"
+#include "graph.h"
 
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
 #include <vector>
 
+// Slots of the alias tables: slot e keeps the probability of taking arc e
+// itself and the vertex to jump to otherwise. keep() tosses the coin of a
+// slot with the next draws of rng. draw() fills out[0, m) from the words w,
+// for a row of n slots from first: the high half of a word picks the slot
+// and the low half is its coin. forArrays(s, f) calls f on every array of s,
+// of one entry per arc, e.g. to save them. The arrays are left
+// uninitialized by resize(), so that the threads building the rows of the
+// tables touch their pages first.
+
+// the probabilities as doubles and the aliases in an array of their own
+struct WideSlots {
+    static const int BYTES = sizeof(double) + sizeof(int);
+
+    Array<double> prob;
+    Array<int> alias;
+
+    void resize(long m) {
+        prob.resize(m);
+        alias.resize(m);
+    }
+
+    void set(long e, double p, int v) {
+        prob[e] = p;
+        alias[e] = v;
+    }
+
+    bool keep(long e, Rng& rng) const {
+        return rng.nextDouble() < prob[e];
+    }
+
+    int getAlias(long e) const {
+        return alias[e];
+    }
+
+    template <typename S, typename F>
+    static void forArrays(S& s, F f) {
+        f(s.prob);
+        f(s.alias);
+    }
+
+    void draw(const uint64_t *w, int m, int n, long first, const int *target,
+            int *out) const;
+};
+
+// The probabilities as 32-bit fixed-point thresholds, next to their alias:
+// 8 bytes a slot instead of 12, and a single cache line to read. Any
+// probability is off by less than 2^-32.
+struct CompactSlots {
+    struct Slot {
+        uint32_t cut;
+        int alias;
+    };
+    static const int BYTES = sizeof(Slot);
+
+    Array<Slot> slot;
+
+    void resize(long m) {
+        slot.resize(m);
+    }
+
+    // 1 is kept as the largest cut, these slots aliasing their own arc
+    void set(long e, double p, int v) {
+        slot[e].cut = (p >= 1) ? UINT32_MAX : (uint32_t) (p * 0x1p32);
+        slot[e].alias = v;
+    }
+
+    bool keep(long e, Rng& rng) const {
+        return (uint32_t) (rng() >> 32) < slot[e].cut;
+    }
+
+    int getAlias(long e) const {
+        return slot[e].alias;
+    }
+
+    template <typename S, typename F>
+    static void forArrays(S& s, F f) {
+        f(s.slot);
+    }
+
+    void draw(const uint64_t *w, int m, int n, long first, const int *target,
+            int *out) const;
+};
+
 // Source: http://www.keithschwarz.com/darts-dice-coins/
-class Sampler {
+//
+// One alias table per vertex, laid out over the CSR arcs of the graph, in
+// the slots of Slots. The sampler reads the offsets, targets and weights of
+// the graph it was built from, which must outlive it; a replica has offsets
+// and targets of its own.
+template <typename Slots>
+class AliasSampler {
 public:
-    Sampler(const std::vector< std::pair<int, double> >& p);
+    AliasSampler() {}
+    AliasSampler(const Graph& g);
 
-    int generate() {
-        int col = (int) (random_double*n);
-        int ind = (random_double < prob[col]) ? col : alias[col];
-        return objects[ind];
+    // adopts the tables of g built before, e.g. by a checkpoint
+    AliasSampler(const Graph& g, Slots _slots): slots(std::move(_slots)) {
+        bind(g);
+    }
+
+    // the offsets and targets point into the arrays of their owner
+    AliasSampler(const AliasSampler&) = delete;
+    AliasSampler& operator=(const AliasSampler&) = delete;
+    AliasSampler(AliasSampler&&) = default;
+    AliasSampler& operator=(AliasSampler&&) = default;
+
+    // A copy of the tables of g, and of the offsets and targets they are
+    // read with, written by the calling thread: with first-touch it lands on
+    // the NUMA node of that thread, for the walks of its socket to read.
+    AliasSampler replicate(const Graph& g) const;
+
+    const Slots& getSlots() const {
+        return slots;
+    }
+
+    // rebuilds the table of u from the weights of g, e.g. once they changed
+    void update(const Graph& g, int u);
+
+    // bytes of the tables per arc, besides the targets of the graph
+    static int getBytesPerArc() {
+        return Slots::BYTES;
+    }
+
+    // neighbor of u picked with probability w_uv/d_u
+    int generate(int u, Rng& rng) const {
+        long first = offset[u];
+        int n = (int) (offset[u + 1] - first);
+
+        long col = first + (long) (rng.nextDouble()*n);
+        return slots.keep(col, rng) ? target[col] : slots.getAlias(col);
+    }
+
+    // Fills out[0, count) with neighbors of u. Each takes one word of rng,
+    // whose high half picks the slot and low half tosses its coin, and the
+    // alias lookups are gathered 8 at a time with AVX-512 or 4 with AVX2 when
+    // built for them (make native=1). Any build draws the same neighbors.
+    void generate(int u, int count, int *out, RngLanes& rng) const;
+
+    // Calls f(v, c) for every neighbor v of u that c > 0 of count packets
+    // move to. The multinomial split is drawn as one binomial per arc, for
+    // the share of the weight left, which beats count draws once count is
+    // far above the degree of u.
+    template <typename F>
+    void scatter(int u, int count, Rng& rng, F f) const {
+        long end = offset[u + 1];
+        double left = deg[u];
+        for (long e = offset[u]; e < end and count > 0; ++e) {
+            int c = count;
+            if (e + 1 < end) {
+                double p = std::min(1.0, weight[e]/left);
+                c = std::binomial_distribution<int>(count, p)(rng);
+            }
+            left -= weight[e];
+            count -= c;
+            if (c) f(target[e], c);
+        }
     }
 
 private:
-    int n;
-    std::vector<int> objects;
+    const long *offset = nullptr;
+    const int *target = nullptr;
+    const double *weight = nullptr;
+    const double *deg = nullptr;
+
+    Slots slots;
 
-    std::vector<int> alias;
-    std::vector<double> prob;
+    // the own offsets and targets of a replica, empty otherwise
+    Array<long> ownOffset;
+    Array<int> ownTarget;
 
-    void init(std::vector<double>& p);
+    void bind(const Graph& g) {
+        offset = g.getOffsets().data();
+        target = g.getTargets().data();
+        weight = g.getWeights().data();
+        deg = g.getDegreeMatrix().data();
+    }
+
+    void init(const Graph& g, int u,
+            std::vector<double>& P,
+            std::vector<int>& small,
+            std::vector<int>& large);
 };
 
+typedef AliasSampler<WideSlots> Sampler;
+typedef AliasSampler<CompactSlots> CompactSampler;
+
 #endif
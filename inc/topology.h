@@ -0,0 +1,39 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <vector>
+
+// The CPUs this process may run on and the socket of each, read from
+// /sys/devices/system/cpu once; a CPU whose package cannot be read counts as
+// socket 0. Sockets are numbered from 0 in the order they are first seen.
+class Topology {
+public:
+    static const Topology& get();
+
+    int getNumSockets() const {
+        return nsockets;
+    }
+
+    int getSocket(int cpu) const;
+
+    // The CPUs in the order threads are to take them. Compact fills the
+    // cores of a socket, the hyperthreads of a core next to each other,
+    // before going on to the next socket; spread deals them out over the
+    // sockets in turn, a core each.
+    const std::vector<int>& getOrder(bool spread) const {
+        return spread ? spreadOrder : compactOrder;
+    }
+
+    // binds the calling thread to cpu; false if the OS refuses
+    static bool pin(int cpu);
+
+private:
+    Topology();
+
+    int nsockets = 1;
+    std::vector<int> socket;
+    std::vector<int> compactOrder;
+    std::vector<int> spreadOrder;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include "array.h"
+#include "partition.h"
+
+#include <omp.h>
+
+#include <vector>
+
+// Memory the kernels reuse from one epoch and beta candidate to the next
+// instead of allocating it anew. The arrays of one entry per vertex are
+// written by the thread that owns each vertex in the kernels, the one of
+// block tid of Partition(first, last, T) that drains its queue, so that they
+// are first touched there and only ever grow. The scratch of every thread
+// is grown by that thread on its first use.
+class Workspace {
+public:
+    struct alignas(64) Scratch {
+        // neighbors drawn in a batch by hop()
+        std::vector<int> draws;
+        // walks of pll_v2 bound for the nodes of every rank
+        std::vector< std::vector<int> > away;
+    };
+
+    // for the vertices [first, last) of the n simulated by this rank, on T
+    // threads and P ranks; cheap when nothing changed
+    void init(int _n, int _first, int _last, int T, int P) {
+        n = _n, first = _first, last = _last, nthreads = T;
+        scratch.resize(nthreads);
+        for (auto& s: scratch) s.away.resize(P);
+        out.resize(P);
+    }
+
+    Scratch& get(int tid) {
+        return scratch[tid];
+    }
+
+    // f(i) for every i of [0, n), each thread on the block it owns; the
+    // nodes of the other ranks are dealt out in equal chunks
+    template <typename F>
+    void forAll(F f) const {
+        Partition blocks(first, last, nthreads);
+#pragma omp parallel num_threads(nthreads)
+        {
+            int tid = omp_get_thread_num();
+            for (int i = blocks.first(tid); i < blocks.first(tid + 1); ++i) {
+                f(i);
+            }
+#pragma omp for nowait
+            for (int i = 0; i < first; ++i) f(i);
+#pragma omp for nowait
+            for (int i = last; i < n; ++i) f(i);
+        }
+    }
+
+    // v = copies arrays of n values of value, one after the other
+    template <typename T, typename A>
+    void fill(std::vector<T, A>& v, T value, int copies = 1) const {
+        v.resize((long) copies * n);
+        forAll([&](int i) {
+            for (long c = 0; c < copies; ++c) {
+                v[c * n + i] = value;
+            }
+        });
+    }
+
+    template <typename T, typename A>
+    void copy(std::vector<T, A>& v, const std::vector<T, A>& from) const {
+        v.resize(n);
+        forAll([&](int i) { v[i] = from[i]; });
+    }
+
+    // the queues of a state put aside, e.g. of the last beta admitted
+    Array<int> savedQ;
+
+    // packets arriving in a step of the serial kernel
+    Array<int> inQ;
+
+    // the walks of a round of pll_v2 sent to every rank, and received
+    std::vector< std::vector<int> > out;
+    std::vector<int> in;
+
+private:
+    int n = 0;
+    int first = 0;
+    int last = 0;
+    int nthreads = 1;
+
+    std::vector<Scratch> scratch;
+};
+
+#endif
@@ -1,9 +1,9 @@
 #!/bin/bash
 
+make -kj
+
 for p in 4
 do
-    make clean
-    make np=$p -kj
     #for i in 4941 10680 #23166 #34761 77360 154908
     for i in 2000 5000 7000 10000 #20000 30000
     #for i in 5000 8000 15000
@@ -14,7 +14,7 @@ do
         #    python3 testgen.py $i
         #fi
 
-        ./main $i.inp $i.out
+        ./main -t $p $i.inp $i.out
         if [ $i -lt 15000 ]; then
             python3 checkSolution.py $i.inp $i.out
             mv $i.ans ans/
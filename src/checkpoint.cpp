@@ -0,0 +1,137 @@
+#include "lsolver.h"
+#include "checkpoint.h"
+#include "io.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+const char CHECKPOINT_MAGIC[8] = {'L', 'S', 'O', 'L', 'V', 'C', '0', '2'};
+
+[[noreturn]] static void fail(const char *fname, const char *what) {
+    std::cerr << fname << ": " << what << '\n';
+    exit(1);
+}
+
+static size_t padded(size_t bytes) {
+    return (bytes + 7)/8*8;
+}
+
+void Lsolver::save(const char *fname) const {
+    assert(Cluster::getNumRanks() == 1);
+
+    std::ofstream outfile(fname, std::ios::binary);
+    if (not outfile) fail(fname, "cannot create");
+
+    bool solved = (eta.size() == (size_t) n and Q.size() == (size_t) n);
+
+    CheckpointHeader h;
+    memcpy(h.magic, CHECKPOINT_MAGIC, sizeof h.magic);
+    h.n = n;
+    h.narcs = g.getNumArcs();
+    h.graphHash = g.getHash(order);
+    h.slotBytes = WalkSampler::getBytesPerArc();
+    h.norder = (long) order.size();
+    h.nstate = solved ? n : 0;
+    h.nstreams = (long) rng.size();
+    h.sink = solved ? sink : -1;
+    h.beta = solved ? beta : 0;
+
+    auto write = [&](const auto& v) {
+        static const char zeros[8] = {};
+        size_t bytes = v.size() * sizeof v[0];
+        outfile.write((const char *) v.data(), bytes);
+        outfile.write(zeros, padded(bytes) - bytes);
+    };
+
+    outfile.write((const char *) &h, sizeof h);
+    write(g.getOffsets());
+    write(g.getTargets());
+    write(g.getWeights());
+
+    const auto& slots = sampler.getSlots();
+    std::decay_t<decltype(slots)>::forArrays(slots, write);
+
+    write(order);
+    if (solved) {
+        write(eta);
+        write(Q);
+    }
+    write(rng);
+    write(lanes);
+
+    if (not outfile) fail(fname, "write failed");
+}
+
+Lsolver::Lsolver(const char *checkpoint) {
+    assert(Cluster::getNumRanks() == 1);
+    auto start = std::chrono::steady_clock::now();
+
+    MappedFile f(checkpoint);
+    if (f.size < sizeof(CheckpointHeader)) fail(checkpoint, "truncated header");
+
+    CheckpointHeader h;
+    memcpy(&h, f.data, sizeof h);
+    if (memcmp(h.magic, CHECKPOINT_MAGIC, sizeof h.magic) != 0) {
+        fail(checkpoint, "not a checkpoint");
+    }
+    if (h.slotBytes != WalkSampler::getBytesPerArc()) {
+        fail(checkpoint, "saved with the other alias tables (make compact=1)");
+    }
+
+    // every array is copied out of the mapping, which is then dropped
+    const char *p = f.data + sizeof h;
+    const char *end = f.data + f.size;
+    auto read = [&](auto& v, long count) {
+        size_t bytes = count * sizeof v[0];
+        if (count < 0 or (size_t) (end - p) < padded(bytes)) {
+            fail(checkpoint, "size does not match its header");
+        }
+        v.resize(count);
+        memcpy((void *) v.data(), p, bytes);
+        p += padded(bytes);
+    };
+
+    std::vector<long> offset;
+    std::vector<int> target;
+    std::vector<double> weight;
+    read(offset, h.n + 1);
+    read(target, h.narcs);
+    read(weight, h.narcs);
+    if (offset[h.n] != h.narcs) fail(checkpoint, "corrupt offsets");
+    g.setCsr((int) h.n, std::move(offset), std::move(target),
+            std::move(weight));
+
+    std::decay_t<decltype(sampler.getSlots())> slots;
+    decltype(slots)::forArrays(slots, [&](auto& v) { read(v, h.narcs); });
+    sampler = WalkSampler(g, std::move(slots));
+
+    read(order, h.norder);
+    position.resize(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (order[i] < 0 or order[i] >= h.n) fail(checkpoint, "corrupt order");
+        position[order[i]] = (int) i;
+    }
+    read(eta, h.nstate);
+    read(Q, h.nstate);
+    read(rng, h.nstreams);
+    read(lanes, h.nstreams);
+    if (p != end) fail(checkpoint, "size does not match its header");
+    if (g.getHash(order) != h.graphHash) fail(checkpoint, "corrupt graph");
+
+    n = g.getNumVertex();
+    first = 0;
+    last = n;
+
+    beta = h.beta;
+    sink = lastSink = (int) h.sink;
+    resume = (h.nstate > 0);
+    restored = (h.nstreams > 0);
+
+    metrics.init = std::chrono::duration_cast<
+        std::chrono::duration<double> >(
+                std::chrono::steady_clock::now() - start).count();
+}
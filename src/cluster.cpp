@@ -0,0 +1,126 @@
+#include "cluster.h"
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+#include <iostream>
+
+#ifdef USE_MPI
+
+// as read by init; a single rank makes no MPI calls after it
+static int rank = 0;
+static int numRanks = 1;
+
+void Cluster::init(int *argc, char ***argv) {
+    // kernels talk to the other ranks from a single thread at a time
+    int provided;
+    MPI_Init_thread(argc, argv, MPI_THREAD_SERIALIZED, &provided);
+    if (provided < MPI_THREAD_SERIALIZED) {
+        std::cerr << "MPI does not support MPI_THREAD_SERIALIZED\n";
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+}
+
+void Cluster::finalize() {
+    MPI_Finalize();
+}
+
+int Cluster::getRank() {
+    return rank;
+}
+
+int Cluster::getNumRanks() {
+    return numRanks;
+}
+
+long Cluster::sum(long x) {
+    if (numRanks == 1) return x;
+    MPI_Allreduce(MPI_IN_PLACE, &x, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+    return x;
+}
+
+double Cluster::sum(double x) {
+    if (numRanks == 1) return x;
+    MPI_Allreduce(MPI_IN_PLACE, &x, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    return x;
+}
+
+double Cluster::max(double x) {
+    if (numRanks == 1) return x;
+    MPI_Allreduce(MPI_IN_PLACE, &x, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    return x;
+}
+
+void Cluster::sum(std::vector<double>& x) {
+    if (numRanks == 1) return;
+    MPI_Allreduce(MPI_IN_PLACE, x.data(), (int) x.size(), MPI_DOUBLE, MPI_SUM,
+            MPI_COMM_WORLD);
+}
+
+void Cluster::exchange(std::vector< std::vector<int> >& out,
+        std::vector<int>& in) {
+    int P = getNumRanks();
+
+    std::vector<int> sendCount(P), sendOffset(P);
+    std::vector<int> recvCount(P), recvOffset(P);
+    std::vector<int> send;
+    for (int r = 0; r < P; ++r) {
+        sendOffset[r] = (int) send.size();
+        sendCount[r] = (int) out[r].size();
+        send.insert(send.end(), out[r].begin(), out[r].end());
+        out[r].clear();
+    }
+
+    MPI_Alltoall(sendCount.data(), 1, MPI_INT, recvCount.data(), 1, MPI_INT,
+            MPI_COMM_WORLD);
+
+    int total = 0;
+    for (int r = 0; r < P; ++r) {
+        recvOffset[r] = total;
+        total += recvCount[r];
+    }
+    in.resize(total);
+
+    MPI_Alltoallv(send.data(), sendCount.data(), sendOffset.data(), MPI_INT,
+            in.data(), recvCount.data(), recvOffset.data(), MPI_INT,
+            MPI_COMM_WORLD);
+}
+
+#else
+
+void Cluster::init(int *argc, char ***argv) {}
+
+void Cluster::finalize() {}
+
+int Cluster::getRank() {
+    return 0;
+}
+
+int Cluster::getNumRanks() {
+    return 1;
+}
+
+long Cluster::sum(long x) {
+    return x;
+}
+
+double Cluster::sum(double x) {
+    return x;
+}
+
+double Cluster::max(double x) {
+    return x;
+}
+
+void Cluster::sum(std::vector<double>& x) {}
+
+void Cluster::exchange(std::vector< std::vector<int> >& out,
+        std::vector<int>& in) {
+    in.swap(out[0]);
+    out[0].clear();
+}
+
+#endif
@@ -0,0 +1,103 @@
+#include "generators.h"
+
+#include <set>
+#include <utility>
+#include <algorithm>
+
+static double weight(Rng& rng) {
+    return 0.1 + 0.9 * rng.nextDouble();
+}
+
+static int pick(int n, Rng& rng) {
+    return (int) (rng.nextDouble() * n);
+}
+
+Graph randomGraph(int n, double avgDegree, Rng& rng) {
+    long m = std::max((long) (n * avgDegree/2), (long) n - 1);
+    m = std::min(m, (long) n * (n - 1)/2);
+
+    Graph g(n);
+    g.reserve(m);
+    std::set< std::pair<int, int> > edges;
+    auto add = [&](int u, int v) {
+        if (u > v) std::swap(u, v);
+        if (u == v or not edges.insert({u, v}).second) return;
+        g.addEdge(u, v, weight(rng));
+    };
+
+    // every vertex hangs off an earlier one of a random order
+    std::vector<int> perm(n);
+    for (int i = 0; i < n; ++i) perm[i] = i;
+    std::shuffle(perm.begin(), perm.end(), rng);
+    for (int i = 1; i < n; ++i) {
+        add(perm[i], perm[pick(i, rng)]);
+    }
+
+    while ((long) edges.size() < m) {
+        add(pick(n, rng), pick(n, rng));
+    }
+
+    g.finalize();
+    return g;
+}
+
+Graph gridGraph(int side, Rng& rng) {
+    int n = side * side;
+    Graph g(n);
+    g.reserve(2L * n);
+    for (int i = 0; i < side; ++i) {
+        for (int j = 0; j < side; ++j) {
+            int u = i * side + j;
+            if (j + 1 < side) g.addEdge(u, u + 1, weight(rng));
+            if (i + 1 < side) g.addEdge(u, u + side, weight(rng));
+        }
+    }
+    g.finalize();
+    return g;
+}
+
+Graph powerLawGraph(int n, int m, Rng& rng) {
+    Graph g(n);
+    g.reserve((long) n * m);
+
+    // every arc end once, so that a uniform pick is degree proportional
+    std::vector<int> ends;
+    ends.reserve(2L * n * m);
+
+    int core = std::min(n, m + 1);
+    for (int u = 1; u < core; ++u) {
+        for (int v = 0; v < u; ++v) {
+            g.addEdge(u, v, weight(rng));
+            ends.push_back(u), ends.push_back(v);
+        }
+    }
+
+    std::vector<int> picked;
+    for (int u = core; u < n; ++u) {
+        picked.clear();
+        while ((int) picked.size() < m) {
+            int v = ends[pick((int) ends.size(), rng)];
+            if (std::find(picked.begin(), picked.end(), v) == picked.end()) {
+                picked.push_back(v);
+            }
+        }
+        for (int v: picked) {
+            g.addEdge(u, v, weight(rng));
+            ends.push_back(u), ends.push_back(v);
+        }
+    }
+
+    g.finalize();
+    return g;
+}
+
+std::vector<double> oneSinkRhs(int n, int nsources, Rng& rng) {
+    std::vector<double> b(n, 0);
+    nsources = std::min(nsources, n - 1);
+    for (int k = 0; k < nsources; ) {
+        int u = pick(n - 1, rng);
+        if (b[u] == 0) b[u] = 1, ++k;
+    }
+    b[n - 1] = -nsources;
+    return b;
+}
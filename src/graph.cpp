@@ -0,0 +1,206 @@
+#include "graph.h"
+
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+void Graph::finalize() {
+    if (edges.empty()) return;
+
+    // counting sort of the arcs by their tail; arcs already in the CSR keep
+    // their place at the front of their row
+    std::vector<long> newOffset(n + 1, 0);
+    for (int u = 0; u < n; ++u) {
+        newOffset[u + 1] = offset[u + 1] - offset[u];
+    }
+    for (const auto& e: edges) {
+        ++newOffset[e.u + 1];
+        ++newOffset[e.v + 1];
+    }
+    for (int u = 0; u < n; ++u) {
+        newOffset[u + 1] += newOffset[u];
+    }
+
+    std::vector<int> newTarget(newOffset[n]);
+    std::vector<double> newWeight(newOffset[n]);
+
+    std::vector<long> pos(newOffset.begin(), newOffset.end() - 1);
+    for (int u = 0; u < n; ++u) {
+        for (long e = offset[u]; e < offset[u + 1]; ++e) {
+            newTarget[pos[u]] = target[e];
+            newWeight[pos[u]++] = weight[e];
+        }
+    }
+    for (const auto& e: edges) {
+        newTarget[pos[e.u]] = e.v;
+        newWeight[pos[e.u]++] = e.w;
+
+        newTarget[pos[e.v]] = e.u;
+        newWeight[pos[e.v]++] = e.w;
+    }
+
+    offset.swap(newOffset);
+    target.swap(newTarget);
+    weight.swap(newWeight);
+
+    edges.clear();
+    edges.shrink_to_fit();
+}
+
+void Graph::setCsr(int _n, std::vector<long> _offset, std::vector<int> _target,
+        std::vector<double> _weight) {
+    n = _n;
+    offset = std::move(_offset);
+    target = std::move(_target);
+    weight = std::move(_weight);
+    edges.clear();
+
+    deg.assign(n, 0);
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (int u = 0; u < n; ++u) {
+        double d = 0;
+        for (long e = offset[u]; e < offset[u + 1]; ++e) {
+            d += weight[e];
+        }
+        deg[u] = d;
+    }
+}
+
+void Graph::keepRows(int first, int last) {
+    finalize();
+
+    long begin = offset[first];
+    long end = offset[last];
+    target = std::vector<int>(target.begin() + begin, target.begin() + end);
+    weight = std::vector<double>(weight.begin() + begin,
+            weight.begin() + end);
+
+    for (int u = 0; u <= n; ++u) {
+        offset[u] = std::min(std::max(offset[u], begin), end) - begin;
+    }
+}
+
+void Graph::permute(const std::vector<int>& order) {
+    finalize();
+
+    std::vector<int> position(n);
+    for (int i = 0; i < n; ++i) {
+        position[order[i]] = i;
+    }
+
+    std::vector<long> newOffset(n + 1, 0);
+    for (int i = 0; i < n; ++i) {
+        newOffset[i + 1] = newOffset[i] + getDegree(order[i]);
+    }
+
+    std::vector<int> newTarget(target.size());
+    std::vector<double> newWeight(weight.size());
+    std::vector<double> newDeg(n);
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (int i = 0; i < n; ++i) {
+        int u = order[i];
+        long e = newOffset[i];
+        for (long f = offset[u]; f < offset[u + 1]; ++f, ++e) {
+            newTarget[e] = position[target[f]];
+            newWeight[e] = weight[f];
+        }
+        newDeg[i] = deg[u];
+    }
+
+    offset.swap(newOffset);
+    target.swap(newTarget);
+    weight.swap(newWeight);
+    deg.swap(newDeg);
+}
+
+bool Graph::setWeight(int u, int v, double w) {
+    finalize();
+
+    auto setRow = [&](int a, int b) {
+        bool found = false;
+        for (long e = offset[a]; e < offset[a + 1]; ++e) {
+            if (target[e] != b) continue;
+            double x = found ? 0 : w;
+            deg[a] += x - weight[e];
+            weight[e] = x;
+            found = true;
+        }
+        return found;
+    };
+    return setRow(u, v) and setRow(v, u);
+}
+
+uint64_t Graph::getHash(const std::vector<int>& order) const {
+    std::vector<int> position;
+    if (not order.empty()) {
+        position.resize(n);
+        for (int i = 0; i < n; ++i) {
+            position[order[i]] = i;
+        }
+    }
+
+    // FNV-1a over 64-bit words instead of bytes
+    uint64_t h = 14695981039346656037ULL;
+    auto mix = [&h](uint64_t x) { h = (h ^ x) * 1099511628211ULL; };
+    mix((uint64_t) n);
+    for (int v = 0; v < n; ++v) {
+        int u = order.empty() ? v : position[v];
+        mix((uint64_t) (offset[u + 1] - offset[u]));
+        for (long e = offset[u]; e < offset[u + 1]; ++e) {
+            uint64_t w;
+            memcpy(&w, &weight[e], sizeof w);
+            mix((uint64_t) (order.empty() ? target[e] : order[target[e]]));
+            mix(w);
+        }
+    }
+    return h;
+}
+
+int Graph::getComponents(std::vector<int>& label) const {
+    std::unique_ptr< std::atomic<int>[] > parent(new std::atomic<int>[n]);
+#pragma omp parallel for
+    for (int u = 0; u < n; ++u) {
+        parent[u].store(u, std::memory_order_relaxed);
+    }
+
+    // with path halving: pointing u at its grandparent keeps it under the
+    // same root
+    auto find = [&](int u) {
+        while (true) {
+            int p = parent[u].load(std::memory_order_relaxed);
+            int gp = parent[p].load(std::memory_order_relaxed);
+            if (p == gp) return p;
+            parent[u].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+            u = gp;
+        }
+    };
+
+    // roots are only ever hooked under a smaller root, so no cycle can form
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (int u = 0; u < n; ++u) {
+        for (long e = offset[u]; e < offset[u + 1]; ++e) {
+            int v = target[e];
+            if (v > u or weight[e] == 0) continue;
+
+            while (true) {
+                int ru = find(u);
+                int rv = find(v);
+                if (ru == rv) break;
+                if (ru < rv) std::swap(ru, rv);
+                if (parent[ru].compare_exchange_weak(ru, rv)) break;
+            }
+        }
+    }
+
+    int ncomponents = 0;
+    label.resize(n);
+#pragma omp parallel for reduction(+: ncomponents)
+    for (int u = 0; u < n; ++u) {
+        label[u] = find(u);
+        ncomponents += (label[u] == u);
+    }
+
+    return ncomponents;
+}
@@ -0,0 +1,300 @@
+#include "io.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cctype>
+#include <climits>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <fstream>
+#include <charconv>
+#include <iostream>
+
+const char BINARY_MAGIC[8] = {'L', 'S', 'O', 'L', 'V', 'B', '0', '1'};
+
+const double EPS = 1e-6;
+
+[[noreturn]] static void fail(const char *fname, const char *what) {
+    std::cerr << fname << ": " << what << '\n';
+    exit(1);
+}
+
+MappedFile::MappedFile(const char *fname) {
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) fail(fname, "cannot open");
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) fail(fname, "cannot stat");
+    size = st.st_size;
+    if (size > 0) {
+        data = (const char *) mmap(nullptr, size, PROT_READ, MAP_PRIVATE,
+                fd, 0);
+        if (data == MAP_FAILED) fail(fname, "cannot map");
+        madvise((void *) data, size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (size > 0) munmap((void *) data, size);
+}
+
+class Scanner {
+public:
+    Scanner(const char *_fname, const char *_p, const char *_end):
+        fname(_fname), p(_p), end(_end) {}
+
+    bool done() {
+        skip();
+        return p == end;
+    }
+
+    template <typename T>
+    T next() {
+        skip();
+        T x;
+        auto res = std::from_chars(p, end, x);
+        if (res.ec != std::errc()) fail(fname, "malformed number");
+        p = res.ptr;
+        return x;
+    }
+
+private:
+    const char *fname;
+    const char *p;
+    const char *end;
+
+    void skip() {
+        while (p < end and isspace((unsigned char) *p)) ++p;
+    }
+};
+
+static void readText(const char *fname, const MappedFile& f, Graph& g,
+        std::vector< std::vector<double> >& bs, int part, int nparts) {
+    Scanner in(fname, f.data, f.data + f.size);
+
+    int n = in.next<int>();
+    int m = in.next<int>();
+
+    g.setNumVertex(n);
+    g.reserve(m);
+    for (int i = 0; i < m; ++i) {
+        int u = in.next<int>();
+        int v = in.next<int>();
+        double w = in.next<double>();
+
+        assert(w > EPS);
+        assert(u != v);
+        assert(1 <= u and u <= n and 1 <= v and v <= n);
+
+        g.addEdge(u - 1, v - 1, w);
+    }
+    g.finalize();
+    if (nparts > 1) {
+        Partition parts(0, n, nparts);
+        g.keepRows(parts.first(part), parts.first(part + 1));
+    }
+
+    // every remaining line is one right-hand side
+    while (not in.done()) {
+        std::vector<double> b(n);
+        for (auto& i: b) {
+            i = in.next<double>();
+        }
+        bs.push_back(std::move(b));
+    }
+}
+
+static void readBinary(const char *fname, const MappedFile& f, Graph& g,
+        std::vector< std::vector<double> >& bs, int part, int nparts) {
+    if (f.size < sizeof(BinaryHeader)) fail(fname, "truncated header");
+
+    BinaryHeader h;
+    memcpy(&h, f.data, sizeof h);
+    if (h.n < 1 or h.n > INT_MAX or h.narcs < 0 or h.nrhs < 0) {
+        fail(fname, "corrupt header");
+    }
+
+    long padded = (h.narcs + 1)/2*2;
+    size_t expected = sizeof h + sizeof(long) * (h.n + 1)
+        + sizeof(int) * padded + sizeof(double) * h.narcs
+        + sizeof(double) * h.n * h.nrhs;
+    if (f.size != expected) fail(fname, "size does not match its header");
+
+    const char *p = f.data + sizeof h;
+    auto offset = (const long *) p; p += sizeof(long) * (h.n + 1);
+    auto target = (const int *) p; p += sizeof(int) * padded;
+    auto weight = (const double *) p; p += sizeof(double) * h.narcs;
+    auto b = (const double *) p;
+
+    bool monotonic = (offset[0] == 0 and offset[h.n] == h.narcs);
+    for (long u = 0; u < h.n and monotonic; ++u) {
+        monotonic = (offset[u] <= offset[u + 1]);
+    }
+    if (not monotonic) fail(fname, "corrupt offsets");
+
+    // only the rows of this part are copied out of the mapping, and checked
+    // as readText checks the edges
+    Partition parts(0, h.n, nparts);
+    long begin = offset[parts.first(part)];
+    long end = offset[parts.first(part + 1)];
+
+    bool bad = false;
+#pragma omp parallel for schedule(dynamic, 1024) reduction(||: bad)
+    for (int u = parts.first(part); u < parts.first(part + 1); ++u) {
+        for (long e = offset[u]; e < offset[u + 1]; ++e) {
+            int v = target[e];
+            bad = bad or v < 0 or v >= h.n or v == u or not (weight[e] > EPS);
+        }
+    }
+    if (bad) fail(fname, "corrupt arcs");
+
+    std::vector<long> rows(h.n + 1);
+    for (long u = 0; u <= h.n; ++u) {
+        rows[u] = std::min(std::max(offset[u], begin), end) - begin;
+    }
+
+    g.setCsr(h.n, std::move(rows),
+            std::vector<int>(target + begin, target + end),
+            std::vector<double>(weight + begin, weight + end));
+
+    for (long k = 0; k < h.nrhs; ++k) {
+        bs.emplace_back(b + k * h.n, b + (k + 1) * h.n);
+    }
+}
+
+void readInput(const char *fname, Graph& g,
+        std::vector< std::vector<double> >& bs, int part, int nparts) {
+    MappedFile f(fname);
+    if (f.size >= sizeof BINARY_MAGIC
+            and memcmp(f.data, BINARY_MAGIC, sizeof BINARY_MAGIC) == 0) {
+        readBinary(fname, f, g, bs, part, nparts);
+    } else {
+        readText(fname, f, g, bs, part, nparts);
+    }
+}
+
+// a file written through a buffer of CHUNK bytes
+class ChunkedWriter {
+public:
+    static const size_t CHUNK = 1 << 20;
+
+    ChunkedWriter(const char *_fname): fname(_fname), buffer(CHUNK) {
+        if (strcmp(fname, "-") == 0) {
+            fd = STDOUT_FILENO;
+        } else {
+            fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) fail(fname, "cannot create");
+        }
+    }
+
+    ~ChunkedWriter() {
+        flush();
+        if (fd != STDOUT_FILENO) close(fd);
+    }
+
+    ChunkedWriter(const ChunkedWriter&) = delete;
+    ChunkedWriter& operator=(const ChunkedWriter&) = delete;
+
+    // room for at least size bytes at the returned position, to be taken with
+    // commit()
+    char *reserve(size_t size) {
+        if (CHUNK - used < size) flush();
+        return buffer.data() + used;
+    }
+
+    void commit(char *end) {
+        used = end - buffer.data();
+    }
+
+    void write(const void *p, size_t size) {
+        if (size > CHUNK) {
+            flush();
+            writeAll((const char *) p, size);
+            return;
+        }
+        memcpy(reserve(size), p, size);
+        used += size;
+    }
+
+    void flush() {
+        writeAll(buffer.data(), used);
+        used = 0;
+    }
+
+private:
+    const char *fname;
+    int fd;
+    std::vector<char> buffer;
+    size_t used = 0;
+
+    void writeAll(const char *p, size_t size) {
+        while (size > 0) {
+            ssize_t k = ::write(fd, p, size);
+            if (k < 0) fail(fname, "write failed");
+            p += k, size -= k;
+        }
+    }
+};
+
+void writeSolutions(const char *fname,
+        const std::vector< std::vector<double> >& xs, OutputFormat format) {
+    ChunkedWriter out(fname);
+    for (const auto& x: xs) {
+        if (format == DOUBLE) {
+            out.write(x.data(), sizeof(double) * x.size());
+        } else if (format == FLOAT) {
+            for (auto i: x) {
+                float f = (float) i;
+                out.write(&f, sizeof f);
+            }
+        } else {
+            // the shortest round-trip form of a double takes up to 24 chars
+            for (auto i: x) {
+                char *p = out.reserve(32);
+                p = std::to_chars(p, p + 31, i).ptr;
+                *p++ = ' ';
+                out.commit(p);
+            }
+            char *p = out.reserve(1);
+            *p++ = '\n';
+            out.commit(p);
+        }
+    }
+}
+
+void writeBinary(const char *fname, const Graph& g,
+        const std::vector< std::vector<double> >& bs) {
+    std::ofstream outfile(fname, std::ios::binary);
+    if (not outfile) fail(fname, "cannot create");
+
+    BinaryHeader h;
+    memcpy(h.magic, BINARY_MAGIC, sizeof h.magic);
+    h.n = g.getNumVertex();
+    h.narcs = g.getNumArcs();
+    h.nrhs = (long) bs.size();
+
+    auto write = [&](const void *p, size_t size) {
+        outfile.write((const char *) p, size);
+    };
+
+    write(&h, sizeof h);
+    write(g.getOffsets().data(), sizeof(long) * (h.n + 1));
+    write(g.getTargets().data(), sizeof(int) * h.narcs);
+    if (h.narcs % 2) {
+        int pad = 0;
+        write(&pad, sizeof pad);
+    }
+    write(g.getWeights().data(), sizeof(double) * h.narcs);
+    for (const auto& b: bs) {
+        assert((long) b.size() == h.n);
+        write(b.data(), sizeof(double) * h.n);
+    }
+
+    if (not outfile) fail(fname, "write failed");
+}
@@ -1,18 +1,19 @@
-#include "rng.h"
 #include "lsolver.h"
+#include "reorder.h"
+#include "topology.h"
 
 #include <omp.h>
 #include <math.h>
 #include <assert.h>
 
-#include <bitset>
 #include <chrono>
+#include <cstdlib>
 #include <numeric>
 #include <iostream>
 #include <algorithm>
 
-template <typename T>
-inline T max(const std::vector<T>& a) {
+template <typename V>
+inline typename V::value_type max(const V& a) {
     return *std::max_element(a.begin(), a.end());
 }
 
@@ -21,8 +22,8 @@ inline T sum(const std::vector<T>& a) {
     return std::accumulate(a.begin(), a.end(), (T) 0);
 }
 
-template <typename T>
-double norm(const std::vector<T>& a) {
+template <typename V>
+double norm(const V& a) {
     double s = 0;
     for (const auto& i: a) {
         s += i*i;
@@ -30,250 +31,792 @@ double norm(const std::vector<T>& a) {
     return sqrt(s);
 }
 
-template <typename T>
-double err(const std::vector<T>& oldQ, const std::vector<T>& Q) {
-    int n = (int) Q.size();
-    std::vector<T> diff(n);
-    for (int i = 0; i < n; ++i) {
-        diff[i] = oldQ[i] - Q[i];
+template <typename V>
+double err(const V& oldQ, const V& Q) {
+    double d = 0;
+    for (size_t i = 0; i < Q.size(); ++i) {
+        double diff = (double) oldQ[i] - Q[i];
+        d += diff*diff;
     }
-    return norm(diff)/norm(oldQ);
+    return sqrt(d)/norm(oldQ);
 }
 
-void Lsolver::initGraph(const Graph& g) {
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast< std::chrono::duration<double> >(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+// adds the wall time of its scope to slot and calls the hook around it
+class PhaseTimer {
+public:
+    PhaseTimer(const Lsolver::PhaseHook& _hook, const char *_phase,
+            double& _slot): hook(_hook), phase(_phase), slot(_slot) {
+        if (hook) hook(phase, true);
+        start = std::chrono::steady_clock::now();
+    }
+
+    ~PhaseTimer() {
+        slot += secondsSince(start);
+        if (hook) hook(phase, false);
+    }
+
+private:
+    const Lsolver::PhaseHook& hook;
+    const char *phase;
+    double& slot;
+    std::chrono::steady_clock::time_point start;
+};
+
+void Lsolver::initGraph() {
+    auto start = std::chrono::steady_clock::now();
+    g.finalize();
+
     n = g.getNumVertex();
-    d = g.getDegreeMatrix();
+    sampler = WalkSampler(g);
+
+    int rank = Cluster::getRank();
+    first = Cluster::getPartition(n).first(rank);
+    last = Cluster::getPartition(n).first(rank + 1);
 
-    adj.resize(n), sampler.reserve(n);
+    metrics.init = secondsSince(start);
+}
+
+// b is in the input numbering and s its sink
+void Lsolver::computeJ(const std::vector<double>& b, int s) {
+    b_sink = b[s];
+    sink = order.empty() ? s : position[s];
+
+    J.resize(n);
+    work.forAll([&](int i) {
+        J[i] = -b[order.empty() ? i : order[i]]/b_sink;
+    });
+}
+
+void Lsolver::reorder() {
+    assert(Cluster::getNumRanks() == 1);
+
+    auto o = rcmOrder(g);
+    g.permute(o);
+    sampler = WalkSampler(g);
+
+    // composed with an earlier order; J is derived again by every solve
+    if (not order.empty()) {
+        for (auto& i: o) i = order[i];
+    }
+    order.swap(o);
+    position.resize(n);
     for (int i = 0; i < n; ++i) {
-        adj[i] = g.getNeighbors(i);
-        for (auto& j: adj[i]) {
-            j.second /= d[i];
+        position[order[i]] = i;
+    }
+
+    // the queues of the last solve are in the old numbering
+    resume = false;
+}
+
+void Lsolver::updateEdge(int u, int v, double w) {
+    assert(Cluster::getNumRanks() == 1);
+    assert(u != v and w >= 0);
+    int inU = u, inV = v;
+
+    if (not order.empty()) {
+        u = position[u];
+        v = position[v];
+    }
+
+    if (g.setWeight(u, v, w)) {
+        // a walk could neither leave a vertex of degree 0 nor reach the sink
+        // from the other side of a cut, so this fails as the input would
+        if (w == 0) {
+            const auto& d = g.getDegreeMatrix();
+            std::vector<int> label;
+            if (d[u] == 0 or d[v] == 0) {
+                std::cerr << "Removing the edge " << inU + 1 << " " << inV + 1
+                          << " leaves vertex " << (d[u] == 0 ? inU : inV) + 1
+                          << " with degree 0\n";
+                exit(1);
+            }
+            if (g.getComponents(label) > 1) {
+                std::cerr << "Removing the edge " << inU + 1 << " " << inV + 1
+                          << " disconnects the graph\n";
+                exit(1);
+            }
         }
-        sampler.push_back(Sampler(adj[i]));
+        sampler.update(g, u);
+        sampler.update(g, v);
+    } else if (w == 0) {
+        // there is no such edge to remove
+        return;
+    } else {
+        g.addEdge(u, v, w);
+        g.finalize();
+        sampler = WalkSampler(g);
     }
+    resume = true;
 }
 
-void Lsolver::computeJ(const std::vector<double>& b) {
-    nsources = std::count_if(b.begin(), b.end(),
-            [](const auto& i) { return i > 0; });
+// average degrees from which K is cut down, and how far above it the
+// largest degree must be for the graph to count as having hubs
+const double DENSE_DEGREE = 64;
+const double MEDIUM_DEGREE = 16;
+const double HUB_RATIO = 16;
 
-    b_sink = b.back();
-    J.resize(n);
-#pragma omp parallel for
-    for (int i = 0; i < n; ++i) {
-        J[i] = -b[i]/b_sink;
+int Lsolver::autoWalkLength() const {
+    int maxDegree = 0;
+    for (int u = first; u < last; ++u) {
+        maxDegree = std::max(maxDegree, g.getDegree(u));
+    }
+    double avg = (double) Cluster::sum((long) g.getNumArcs())/n;
+    double hub = Cluster::max((double) maxDegree);
+
+    if (avg >= DENSE_DEGREE) return 8;
+    if (avg >= MEDIUM_DEGREE) return 16;
+    return hub >= HUB_RATIO * avg ? 64 : 32;
+}
+
+int Lsolver::getNumThreads() const {
+    return nthreads > 0 ? nthreads : omp_get_max_threads();
+}
+
+void Lsolver::seedThreads() {
+    int T = getNumThreads();
+    long stream0 = (long) Cluster::getRank() * T;
+    rng.clear(), rng.reserve(T);
+    lanes.clear(), lanes.reserve(T);
+    for (int tid = 0; tid < T; ++tid) {
+        rng.push_back(Rng(seed, stream0 + tid));
+        lanes.push_back(RngLanes(seed, stream0 + tid));
     }
+    replicaParts = 0;
 }
 
-std::vector<double> Lsolver::solve() {
-    auto start = std::chrono::steady_clock::now();
+// Pins the threads of the kernels, which OpenMP keeps from one parallel
+// region to the next, and has the first thread on every socket copy the
+// tables for the others there. The workspace is then filled by the pinned
+// threads.
+void Lsolver::initThreads() {
+    int T = getNumThreads();
+    const auto& topology = Topology::get();
+    const auto& cpus = topology.getOrder(pinning == SPREAD);
+    bool replicate = replicas and pinning != NONE
+        and topology.getNumSockets() > 1;
+
+    replica.clear();
+    replica.resize(replicate ? topology.getNumSockets() : 0);
+    walker.assign(T, &sampler);
+    if (pinning != NONE) {
+#pragma omp parallel num_threads(T)
+        {
+            int tid = omp_get_thread_num();
+            auto cpuOf = [&](int p) { return cpus[p % cpus.size()]; };
+            Topology::pin(cpuOf(tid));
+
+            if (replicate) {
+                int s = topology.getSocket(cpuOf(tid));
+                int p = 0;
+                while (topology.getSocket(cpuOf(p)) != s) ++p;
+                if (p == tid) replica[s] = sampler.replicate(g);
+                walker[tid] = &replica[s];
+            }
+        }
+    }
 
-    omp_set_num_threads(N_THREADS);
+    work.init(n, first, last, T, Cluster::getNumRanks());
+}
 
+// Part part of parts of the threads of parent, for the parallel search:
+// shares its tables, which must outlive it, and copies its source and the
+// settings of its walks. The queues start empty and the threads draw from
+// streams after those of parent and of its earlier replicas, so that every
+// set of replicas is independent of the others. Single process only.
+Lsolver::Lsolver(const Lsolver& parent, int part, int parts):
+        n(parent.n), first(0), last(parent.n), J(parent.J),
+        sink(parent.sink), epochLength(parent.epochLength),
+        batchLength(parent.batchLength), tol(parent.tol), K(parent.K),
+        schedule(parent.schedule), fused(parent.fused),
+        nthreads(std::max(1, parent.getNumThreads()/parts)),
+        seed(parent.seed) {
+    int T = parent.getNumThreads();
+    for (int tid = 0; tid < nthreads; ++tid) {
+        // the tables of the socket of the cpu the thread is pinned to
+        walker.push_back(parent.walker[(part * nthreads + tid) % T]);
+        long stream = (parent.replicaParts + part + 1) * T + tid;
+        rng.push_back(Rng(seed, stream));
+        lanes.push_back(RngLanes(seed, stream));
+    }
+    work.init(n, first, last, nthreads, 1);
+    work.fill(Q, 0), work.fill(cnt, 0);
+}
+
+std::vector<double> Lsolver::solveCurrent() {
     computeStationarityState();
-    auto x = computeX();
 
-    auto finish = std::chrono::steady_clock::now();
-    double elapsed_seconds = std::chrono::duration_cast<
-        std::chrono::duration<double> >(finish - start).count();
+    PhaseTimer timer(hook, "computeX", metrics.computeX);
+    return computeX();
+}
 
-    std::cerr << "Time: " << elapsed_seconds << '\n';
+void Lsolver::startSolve() {
+    if (not restored or (int) rng.size() != getNumThreads()) {
+        seedThreads();
+    }
+    restored = false;
+    if (autoK) K = autoWalkLength();
+    initThreads();
+    betaHint = 0;
+    metrics = Metrics{metrics.init};
+}
+
+// counts are summed over the ranks once, at the end
+void Lsolver::finishSolve(double seconds) {
+    metrics.total = seconds;
+    metrics.hops = Cluster::sum(metrics.hops);
+    metrics.sunk = Cluster::sum(metrics.sunk);
+}
+
+std::vector<double> Lsolver::solve() {
+    auto start = std::chrono::steady_clock::now();
+    startSolve();
+
+    auto x = solveRhs(rhs);
+
+    finishSolve(secondsSince(start));
     return x;
 }
 
-std::vector<double> Lsolver::solve_becchetti() {
-    omp_set_num_threads(N_THREADS);
+// entries of b above -SINK_EPS are round-off rather than sinks, as for the
+// check of b in main.cpp
+const double SINK_EPS = 1e-6;
+
+// x is simulated in the numbering of the solver and returned in that of b
+std::vector<double> Lsolver::solveRhs(const std::vector<double>& b) {
+    std::vector<int> sinks;
+    double mass = 0;
+    for (int i = 0; i < n; ++i) {
+        if (b[i] < -SINK_EPS) sinks.push_back(i), mass -= b[i];
+    }
+    assert(not sinks.empty());
+
+    std::vector<double> x;
+    std::vector<double> var(n, 0);
+    if (sinks.size() == 1) {
+        computeJ(b, sinks[0]);
+        x = solveCurrent();
+        addVariance(var);
+    } else {
+        // superposition of one-sink systems sharing the sources
+        x.assign(n, 0);
+        std::vector<double> part(n);
+        for (int s: sinks) {
+            for (int i = 0; i < n; ++i) {
+                part[i] = b[i] > 0 ? b[i] * (-b[s]/mass) : 0;
+            }
+            part[s] = b[s];
+
+            computeJ(part, s);
+            auto y = solveCurrent();
+            addVariance(var);
+            for (int i = 0; i < n; ++i) {
+                x[i] += y[i];
+            }
+            betaHint = beta;
+        }
+    }
+
+    if (refineTol > 0) {
+        std::vector<double> c(n);
+        for (int i = 0; i < n; ++i) {
+            c[i] = b[order.empty() ? i : order[i]];
+        }
+        PhaseTimer timer(hook, "refine", metrics.refine);
+        metrics.iterations += refine(x, c);
+    }
+
+    // centering for canonical solution
+    auto avg_x = sum(x)/n;
+    std::vector<double> y(n);
+    Cluster::sum(var);
+    stdError.resize(n);
+    for (int i = 0; i < n; ++i) {
+        y[order.empty() ? i : order[i]] = x[i] - avg_x;
+        stdError[order.empty() ? i : order[i]] = sqrt(var[i]);
+    }
+    return y;
+}
+
+std::vector< std::vector<double> > Lsolver::solveBatch(
+        const std::vector< std::vector<double> >& bs) {
+    auto start = std::chrono::steady_clock::now();
+    startSolve();
+
+    std::vector< std::vector<double> > xs;
+    xs.reserve(bs.size());
+    for (const auto& b: bs) {
+        xs.push_back(solveRhs(b));
+        betaHint = beta;
+    }
+
+    finishSolve(secondsSince(start));
+    return xs;
+}
+
+std::vector<double> Lsolver::solve_becchetti(double seconds, double errTol,
+        Progress progress) {
+    assert(Cluster::getNumRanks() == 1);
+    seedThreads();
+    if (autoK) K = autoWalkLength();
+    initThreads();
+
+    // one-sink systems only
+    computeJ(rhs, (int) (std::min_element(rhs.begin(), rhs.end())
+                - rhs.begin()));
 
-    double e = 0;
     beta = 250;
 
-    std::vector<int> oldQ;
+    auto& oldQ = work.savedQ;
     std::vector<double> x(n, 0);
+    const auto& d = g.getDegreeMatrix();
 
-    Q.resize(n, 1);
+    if (Q.size() != (size_t) n) work.fill(Q, 1);
     auto start = std::chrono::steady_clock::now();
-    do {
-        oldQ = Q;
-        becchetti_v1();
-        e = err(oldQ, Q);
-        auto finish = std::chrono::steady_clock::now();
-        double elapsed_seconds = std::chrono::duration_cast<
-            std::chrono::duration<double> >(finish - start).count();
-        std::cerr << elapsed_seconds << '\n';
-        //          << e << '\n';
-        //          << (-b_sink/beta) * (Q[0]/d[0]) << ' '
-        //          << sum(Q) << '\n';
-
-        // for testing/plotting progress
-        Q[n - 1] = 0;
+    while (true) {
+        work.copy(oldQ, Q);
+        becchetti_v1(epochLength);
+        double e = err(oldQ, Q);
+        double elapsed = secondsSince(start);
+
+        // x in the numbering of b, as solve returns it
+        Q[sink] = 0;
         for (int i = 0; i < n; ++i) {
-            x[i] = (-b_sink/beta) * (Q[i]/d[i]);
-            std::cerr << x[i] << ' ';
+            x[order.empty() ? i : order[i]] = (-b_sink/beta) * (Q[i]/d[i]);
         }
-        std::cerr << '\n';
-        if (elapsed_seconds > 60) break;
-    } while (1); // replace with time alloted or e < EPS
+        if (progress and not progress(x, e, elapsed)) break;
+        if (elapsed > seconds or e < errTol) break;
+    }
 
     return x;
 }
 
-inline bool trueWithProbability(double p) {
-    return random_double <= p;
+Lsolver::Progress Lsolver::printProgress(std::ostream& out) {
+    return [&out](const std::vector<double>& x, double, double seconds) {
+        out << seconds << '\n';
+        for (auto i: x) {
+            out << i << ' ';
+        }
+        out << '\n';
+        return true;
+    };
 }
 
-inline int random_round(double p) {
+inline bool trueWithProbability(double p, Rng& rng) {
+    return rng.nextDouble() < p;
+}
+
+inline int random_round(double p, Rng& rng) {
     int q = (int) p;
-    return q + trueWithProbability(p - q);
+    return q + trueWithProbability(p - q, rng);
 }
 
-#ifndef N_THREADS
-#define N_THREADS 16
-#endif
+const int DYNAMIC_CHUNK = 256;
 
-// decrease this for becchetti's
-#define LENGTH_OF_EPOCH 5000
+// a hop, a random read of the alias table, costs about as much as drawing
+// the generation of 8 nodes in a row
+const double HOP_COST = 8;
 
-void Lsolver::pll_v1() {
-    std::vector<int> inQ[N_THREADS];
-#pragma omp parallel
+// cuts [first, last) into T blocks of about equal total cost(i); equal
+// sizes unless BALANCED. Fused steps keep the equal blocks of the exchange,
+// whose owners drain the queues of their own nodes.
+template <typename Cost>
+void Lsolver::rebalance(int T, Cost cost) {
+    chunks[0] = chunks[1] = 0;
+
+    Partition blocks(first, last, T);
+    bounds.resize(T + 1);
+    for (int p = 0; p <= T; ++p) {
+        bounds[p] = p < T ? blocks.first(p) : last;
+    }
+    if (schedule != BALANCED or fused) return;
+
+    double total = 0;
+    for (int i = first; i < last; ++i) {
+        total += cost(i);
+    }
+
+    double acc = 0;
+    int p = 1;
+    for (int i = first; i < last and p < T; ++i) {
+        acc += cost(i);
+        while (p < T and acc >= total * p/T) {
+            bounds[p++] = i + 1;
+        }
+    }
+}
+
+// f(i) for the nodes of this thread in time step t, without a barrier at the
+// end; every thread of the team must call it. Under DYNAMIC the chunks are
+// taken from a counter per parity of t, the other one being reset for the
+// next step while nobody uses it. f is instantiated once, so that it can be
+// inlined into the kernel.
+template <typename F>
+void Lsolver::forNodes(int tid, int t, F f) {
+    bool dynamic = (schedule == DYNAMIC and not fused);
+    if (dynamic and tid == 0) {
+        chunks[(t + 1) & 1].store(0, std::memory_order_relaxed);
+    }
+
+    int begin = bounds[tid];
+    int end = bounds[tid + 1];
+    while (true) {
+        if (dynamic) {
+            long c = chunks[t & 1].fetch_add(1, std::memory_order_relaxed);
+            if (first + c * DYNAMIC_CHUNK >= last) break;
+            begin = (int) (first + c * DYNAMIC_CHUNK);
+            end = std::min(begin + DYNAMIC_CHUNK, last);
+        }
+        for (int i = begin; i < end; ++i) {
+            f(i);
+        }
+        if (not dynamic) break;
+    }
+}
+
+// a binomial costs about as much as 64 alias draws of a batch
+const int MULTINOMIAL_RATIO = 64;
+
+// Moves count packets from i one hop on, calling f(j, c) for the c > 0 of
+// them reaching j. Queues far longer than the degree of i are split at once
+// as a multinomial; others are drawn in a batch of alias lookups, into draws.
+template <typename F>
+void Lsolver::hop(int tid, int i, int count, std::vector<int>& draws, F f) {
+    if (count <= 0) return;
+    if (count >= (long) MULTINOMIAL_RATIO * g.getDegree(i)) {
+        walker[tid]->scatter(i, count, rng[tid], f);
+    } else if (count < RngLanes::LANES) {
+        for (int p = 0; p < count; ++p) {
+            f(walker[tid]->generate(i, rng[tid]), 1);
+        }
+    } else {
+        draws.resize(count);
+        walker[tid]->generate(i, count, draws.data(), lanes[tid]);
+        for (int j: draws) {
+            f(j, 1);
+        }
+    }
+}
+
+void Lsolver::pll_v1(int steps) {
+    int T = getNumThreads();
+    exchange.init(0, n, T, fused ? 2 : 1);
+    rebalance(T, [&](int i) { return 1 + (Q[i] + 1)/2; });
+#pragma omp parallel num_threads(T)
     {
         int tid = omp_get_thread_num();
-        inQ[tid].resize(n, 0);
-        for (int t = 0; t < LENGTH_OF_EPOCH; ++t) {
-#pragma omp for
-            for (int i = 0; i < n - 1; ++i) {
-                Q[i] += trueWithProbability(beta * J[i]);
-                for (int cap = std::max(1, Q[i]/2); Q[i] and cap; --cap) {
-                    --Q[i];
-                    ++cnt[i];
-                    ++inQ[tid][sampler[i].generate()];
-                }
-            }
+        Rng& r = rng[tid];
+        auto& draws = work.get(tid).draws;
+        auto arrive = [&](int v) { ++Q[v]; };
+        for (int t = 0; t < steps; ++t) {
+            int s = fused ? t & 1 : 0;
+            if (fused) exchange.receive(tid, arrive, s ^ 1);
 
-#pragma omp for
-            for (int i = 0; i < n; ++i) {
-                int x = 0;
-                for (int p = 0; p < N_THREADS; ++p) {
-                    x += inQ[p][i], inQ[p][i] = 0;
-                }
-                Q[i] += x;
-            }
+            forNodes(tid, t, [&](int i) {
+                if (i == sink) return;
+                Q[i] += trueWithProbability(beta * J[i], r);
+                int m = std::min(Q[i], std::max(1, Q[i]/2));
+                Q[i] -= m;
+                cnt[i] += m;
+                hop(tid, i, m, draws, [&](int j, int c) {
+                    exchange.send(tid, j, c, s);
+                });
+            });
+#pragma omp barrier
+            if (fused) continue;
+
+            exchange.receive(tid, arrive);
+#pragma omp barrier
         }
+        if (fused) exchange.receive(tid, arrive, (steps - 1) & 1);
     }
 }
 
-#define K 64
-void Lsolver::pll_v2() {
-    std::vector<int> inQ[N_THREADS];
-    // store the path of the packet as a bitset
-    std::vector< std::bitset<K> > via[N_THREADS];
-#pragma omp parallel
+// sets bit in w and tells if w was empty; the lock prefix of the atomic or
+// costs more than the hop itself, so it is skipped when w is not shared and
+// when the bit is set already
+template <typename Word>
+static inline bool mark(Word& w, Word bit, bool shared) {
+    if (not shared) {
+        bool empty = (w == 0);
+        w |= bit;
+        return empty;
+    }
+    if (__atomic_load_n(&w, __ATOMIC_RELAXED) & bit) return false;
+    return __atomic_fetch_or(&w, bit, __ATOMIC_RELAXED) == 0;
+}
+
+// The kernels of the preset walk lengths are compiled for their K, with
+// marks of K bits; any other K runs on the next wider word with K read at
+// runtime.
+void Lsolver::pll_v2(int steps) {
+    switch (K) {
+    case 8: pll_v2_k<8, uint8_t>(steps); break;
+    case 16: pll_v2_k<16, uint16_t>(steps); break;
+    case 32: pll_v2_k<32, uint32_t>(steps); break;
+    case 64: pll_v2_k<64, uint64_t>(steps); break;
+    default:
+        if (K < 8) pll_v2_k<0, uint8_t>(steps);
+        else if (K < 16) pll_v2_k<0, uint16_t>(steps);
+        else if (K < 32) pll_v2_k<0, uint32_t>(steps);
+        else pll_v2_k<0, uint64_t>(steps);
+    }
+}
+
+// HOPS hops per step, or K when 0
+template <int HOPS, typename Word>
+void Lsolver::pll_v2_k(int steps) {
+    const int L = HOPS > 0 ? HOPS : K;
+    int T = getNumThreads();
+    int P = Cluster::getNumRanks();
+    Partition ranks = Cluster::getPartition(n);
+    int buffers = fused ? 2 : 1;
+    exchange.init(first, last, T, buffers);
+    // the path of the packets is stored as one bit per hop in a single word
+    // per node shared by all threads; the first thread to mark a node in a
+    // time step tells its owner, which counts and clears it. Fused steps
+    // mark the words of buffer t & 1 while the last ones are cleared.
+    touched.init(first, last, T, buffers);
+    // every word is cleared again by its owner before the call returns
+    auto& visited = std::get< Array<Word> >(marks);
+    if (visited.size() < (size_t) buffers * n) {
+        work.fill(visited, (Word) 0, buffers);
+    }
+
+    // A walk reaching a node of another rank is sent there as the node and
+    // the hops it has made, batched per thread and destination rank, and the
+    // ranks trade them in rounds until every walk of the step has ended.
+    auto& out = work.out;
+    auto& in = work.in;
+    long pending = 0;
+
+    // a node costs a draw every step and K hops for every walk it started in
+    // the previous call; its queue stands in for that on the first call
+    bool seen = (load.size() == (size_t) n);
+    if (not seen) work.fill(load, 0);
+    rebalance(T, [&](int i) {
+        return seen ? (double) steps + HOP_COST * L * load[i]
+            : 1 + HOP_COST * L * (Q[i] > 0);
+    });
+    std::fill(load.begin() + first, load.begin() + last, 0);
+
+    long sunk0 = Q[sink];
+    if ((int) metrics.busy.size() < T) metrics.busy.resize(T, 0);
+#pragma omp parallel num_threads(T)
     {
         int tid = omp_get_thread_num();
-        inQ[tid].resize(n, 0), via[tid].resize(n);
-        for (int t = 0; t < LENGTH_OF_EPOCH; ++t) {
+        Rng& r = rng[tid];
+        long hops = 0;
+        double busy = 0;
+        // buffer of the packets and marks of this time step
+        int s = 0;
+        Word *vis = visited.data();
 
-#pragma omp for
-            for (int i = 0; i < n - 1; ++i) {
-                Q[i] += trueWithProbability(beta * J[i]);
+        const WalkSampler& tables = *walker[tid];
+
+        auto forward = [&](int j, int k) {
+            auto& o = work.get(tid).away[ranks.owner(j)];
+            o.push_back(j), o.push_back(k);
+        };
+
+        // moves a packet on from its k-th hop at j
+        int lo = first, size = last - first, sink = this->sink;
+        bool shared = T > 1;
+        auto walk = [&](int j, int k) {
+            int k0 = k;
+            for (; k < L and j != sink; ++k) {
+                if ((unsigned) (j - lo) >= (unsigned) size) {
+                    hops += k - k0;
+                    forward(j, k);
+                    return;
+                }
+                if (mark(vis[j], (Word) (1ULL << k), shared)) {
+                    touched.send(tid, j, s);
+                }
+                j = tables.generate(j, r);
+            }
+
+            hops += k - k0;
+            if ((unsigned) (j - lo) >= (unsigned) size) {
+                forward(j, k);
+            } else {
+                exchange.send(tid, j, s);
+            }
+        };
+
+        // queues the packets sent to the nodes of tid and counts their marks
+        auto drain = [&](int buffer) {
+            exchange.receive(tid, [&](int v) { ++Q[v]; }, buffer);
+
+            Word *w = visited.data() + (long) buffer * n;
+            touched.receive(tid, [&](int v) {
+                cnt[v] += __builtin_popcountll(w[v]);
+                w[v] = 0;
+            }, buffer);
+        };
+
+        for (int t = 0; t < steps; ++t) {
+            if (fused) {
+                s = t & 1;
+                vis = visited.data() + (long) s * n;
+                drain(s ^ 1);
+            }
+
+            double start = omp_get_wtime();
+            forNodes(tid, t, [&](int i) {
+                if (i == sink) return;
+                Q[i] += trueWithProbability(beta * J[i], r);
                 if (Q[i]) {
                     --Q[i];
-                    int j = i;
-                    for (int k = 0; k < K and j != n - 1; ++k) {
-                        via[tid][j].set(k);
-                        j = sampler[j].generate();
+                    ++load[i];
+                    walk(i, 0);
+                }
+            });
+            busy += omp_get_wtime() - start;
+#pragma omp barrier
+
+            while (P > 1) {
+#pragma omp single
+                {
+                    for (int p = 0; p < T; ++p) {
+                        for (int q = 0; q < P; ++q) {
+                            auto& away = work.get(p).away[q];
+                            out[q].insert(out[q].end(), away.begin(),
+                                    away.end());
+                            away.clear();
+                        }
                     }
-                    ++inQ[tid][j];
+                    Cluster::exchange(out, in);
+                    pending = Cluster::sum((long) in.size());
                 }
-            }
+                if (pending == 0) break;
 
 #pragma omp for
-            for (int i = 0; i < n; ++i) {
-                int x = 0;
-                std::bitset<K> b;
-                for (int p = 0; p < N_THREADS; ++p) {
-                    x += inQ[p][i], inQ[p][i] = 0;
-                    b |= via[p][i], via[p][i] = 0;
+                for (long m = 0; m < (long) in.size(); m += 2) {
+                    walk(in[m], in[m + 1]);
                 }
-                Q[i] += x;
-                cnt[i] += b.count();
             }
+
+            if (fused) continue;
+
+            drain(0);
+#pragma omp barrier
         }
+        if (fused) drain((steps - 1) & 1);
+
+        metrics.busy[tid] += busy;
+#pragma omp atomic
+        metrics.hops += hops;
     }
+    metrics.sunk += Q[sink] - sunk0;
 }
 
 
 
 // classic
-void Lsolver::becchetti_v1() {
-    std::vector<int> inQ[N_THREADS];
-#pragma omp parallel
+void Lsolver::becchetti_v1(int steps) {
+    int T = getNumThreads();
+    exchange.init(0, n, T, fused ? 2 : 1);
+    rebalance(T, [&](int i) { return 1 + Q[i]; });
+#pragma omp parallel num_threads(T)
     {
         int tid = omp_get_thread_num();
-        inQ[tid].resize(n, 0);
-        for (int t = 0; t < LENGTH_OF_EPOCH; ++t) {
-#pragma omp for
-            for (int i = 0; i < n - 1; ++i) {
-                Q[i] += random_round(beta * J[i]);
-                for (int p = 0; p < Q[i]; ++p) {
-                    ++inQ[tid][sampler[i].generate()];
-                }
-            }
-#pragma omp for
-            for (int i = 0; i < n - 1; ++i) {
-                int x = 0;
-                for (int p = 0; p < N_THREADS; ++p) {
-                    x += inQ[p][i], inQ[p][i] = 0;
-                }
-                Q[i] = x;
-            }
+        Rng& r = rng[tid];
+        auto& draws = work.get(tid).draws;
+        auto arrive = [&](int v) { ++Q[v]; };
+        for (int t = 0; t < steps; ++t) {
+            int s = fused ? t & 1 : 0;
+            if (fused) exchange.receive(tid, arrive, s ^ 1);
+
+            forNodes(tid, t, [&](int i) {
+                if (i == sink) return;
+                Q[i] += random_round(beta * J[i], r);
+                hop(tid, i, Q[i], draws, [&](int j, int c) {
+                    // packets reaching the sink are absorbed
+                    if (j != sink) exchange.send(tid, j, c, s);
+                });
+                Q[i] = 0;
+            });
+#pragma omp barrier
+            if (fused) continue;
+
+            exchange.receive(tid, arrive);
+#pragma omp barrier
         }
+        if (fused) exchange.receive(tid, arrive, (steps - 1) & 1);
     }
 }
 
 
 // k-step speed up
-void Lsolver::becchetti_v2() {
-    std::vector<int> inQ[N_THREADS];
-#pragma omp parallel
+void Lsolver::becchetti_v2(int steps) {
+    switch (K) {
+    case 8: becchetti_v2_k<8>(steps); break;
+    case 16: becchetti_v2_k<16>(steps); break;
+    case 32: becchetti_v2_k<32>(steps); break;
+    case 64: becchetti_v2_k<64>(steps); break;
+    default: becchetti_v2_k<0>(steps);
+    }
+}
+
+template <int HOPS>
+void Lsolver::becchetti_v2_k(int steps) {
+    const int L = HOPS > 0 ? HOPS : K;
+    int T = getNumThreads();
+    exchange.init(0, n, T, fused ? 2 : 1);
+    rebalance(T, [&](int i) { return 1 + (long) L * Q[i]; });
+#pragma omp parallel num_threads(T)
     {
         int tid = omp_get_thread_num();
-        inQ[tid].resize(n, 0);
-        for (int t = 0; t < LENGTH_OF_EPOCH; ++t) {
-#pragma omp for
-            for (int i = 0; i < n - 1; ++i) {
-                Q[i] += K * random_round(beta * J[i]);
-                for (int p = 0; p < Q[i]; ++p) {
-                    int j = i;
-                    for (int k = 0; k < K and j != n - 1; ++k) {
-                        j = sampler[j].generate();
+        Rng& r = rng[tid];
+        auto& draws = work.get(tid).draws;
+        const WalkSampler& tables = *walker[tid];
+        auto arrive = [&](int v) { ++Q[v]; };
+        for (int t = 0; t < steps; ++t) {
+            int s = fused ? t & 1 : 0;
+            if (fused) exchange.receive(tid, arrive, s ^ 1);
+
+            forNodes(tid, t, [&](int i) {
+                if (i == sink) return;
+                Q[i] += L * random_round(beta * J[i], r);
+                // the first hops leave i together, the others are apart
+                hop(tid, i, Q[i], draws, [&](int j0, int c) {
+                    for (; c > 0; --c) {
+                        int j = j0;
+                        for (int k = 1; k < L and j != sink; ++k) {
+                            j = tables.generate(j, r);
+                        }
+                        if (j != sink) exchange.send(tid, j, s);
                     }
-                    ++inQ[tid][j];
-                }
-            }
+                });
+                Q[i] = 0;
+            });
+#pragma omp barrier
+            if (fused) continue;
 
-#pragma omp for
-            for (int i = 0; i < n - 1; ++i) {
-                int x = 0;
-                for (int p = 0; p < N_THREADS; ++p) {
-                    x += inQ[p][i], inQ[p][i] = 0;
-                }
-                Q[i] = x;
-            }
+            exchange.receive(tid, arrive);
+#pragma omp barrier
         }
+        if (fused) exchange.receive(tid, arrive, (steps - 1) & 1);
     }
 }
 
-void Lsolver::serial() {
-    std::vector<int> inQ(n, 0);
-    for (int t = 0; t < LENGTH_OF_EPOCH; ++t) {
-        for (int i = 0; i < n - 1; ++i) {
-            Q[i] += trueWithProbability(beta * J[i]);
+void Lsolver::serial(int steps) {
+    Rng& r = rng[0];
+    auto& inQ = work.inQ;
+    if (inQ.size() != (size_t) n) work.fill(inQ, 0);
+    for (int t = 0; t < steps; ++t) {
+        for (int i = 0; i < n; ++i) {
+            if (i == sink) continue;
+            Q[i] += trueWithProbability(beta * J[i], r);
             if (Q[i] > 0) {
                 --Q[i];
                 ++cnt[i];
-                ++inQ[sampler[i].generate()];
+                ++inQ[sampler.generate(i, r)];
             }
         }
         for (int i = 0; i < n; ++i) {
@@ -283,80 +826,493 @@ void Lsolver::serial() {
     }
 }
 
-const double EPS = 1e-3;
+const double EPS = 0.02;
 const int MIN_EPOCHS = 3;
 const int MAX_EPOCHS = 100;
+const int MIN_BATCHES = 4;
+
+// a candidate beta is taken as ergodic when at least this fraction of the
+// packets generated in an epoch is sunk within it
+const double ERGODIC_C = 0.85;
+const double MIN_BETA = 0.0001;
+
+// The occupancy of a step slot saturates as queues fill up, which biases eta
+// long before the DCP stops being ergodic; candidates whose busiest slot is
+// occupied more often than this are rejected as well.
+const double MAX_OCCUPANCY = 0.05;
+
+// the beta search aims at this occupancy and is done once lo is within
+// BETA_TOL of the cap
+const double TARGET_OCCUPANCY = 0.9 * MAX_OCCUPANCY;
+const double BETA_TOL = 0.8;
+
+// Sink fraction of one epoch: packets sunk over packets generated during the
+// epoch. Unlike the fraction of all packets ever sunk it does not depend on
+// the state the epoch starts from, so candidates can be warm started.
+double Lsolver::runEpoch(int steps) {
+    // the counts are summed over the ranks; only the owner of the sink ever
+    // sinks
+    auto inFlight = [&]() {
+        long s = 0;
+        for (int i = first; i < last; ++i) s += Q[i];
+        return Cluster::sum(s) - Cluster::sum((long) Q[sink]);
+    };
+
+    long sunk0 = Cluster::sum((long) Q[sink]);
+    long inFlight0 = inFlight();
+    work.fill(cnt, 0);
+
+    metrics.epochs.push_back(0);
+    {
+        PhaseTimer timer(hook, "epoch", metrics.epochs.back());
+        pll_v2(steps);
+    }
+    metrics.steps += steps;
 
-double Lsolver::estimateEta(double lastC = 0) {
+    occupancy = Cluster::max((double) max(cnt)/((long) steps * K));
+
+    long sunk = Cluster::sum((long) Q[sink]) - sunk0;
+    long generated = sunk + inFlight() - inFlight0;
+    return (double) sunk/std::max(1L, generated);
+}
+
+bool Lsolver::isAdmissible(double C) const {
+    return C >= ERGODIC_C and occupancy <= MAX_OCCUPANCY;
+}
+
+double Lsolver::mixDCP() {
     int epoch = 0;
     double newC = 0;
 
     while (epoch < MIN_EPOCHS and newC < 0.8) {
         ++epoch;
-        pll_v2();
-        newC = (double) Q[n - 1]/(1 + sum(Q));
+        newC = runEpoch(epochLength);
     }
 
-    // if thres (newC is greater than 0.90) for more than 3 times stop
+    // stationary once about as many packets are sunk as generated; if thres
+    // (newC is greater than 0.90) for more than 3 times stop
     for (int thres = 0; thres < 3 and epoch < MAX_EPOCHS; ++epoch) {
-        auto oldC = newC;
+        newC = runEpoch(epochLength);
 
-        pll_v2();
-        newC = (double) Q[n - 1]/(1 + sum(Q));
-
-        if (beta > 0.001 and fabs(oldC - newC) < EPS) break;
+        if (beta > 0.001 and fabs(1 - newC) < EPS) break;
         thres += (newC > 0.90);
     }
 
-    int T = epoch * LENGTH_OF_EPOCH;
-    std::vector<double> eta0(n);
-    for (int i = 0; i < n; ++i) {
-        eta[i] = eta0[i] = (double) cnt[i]/T;
-        Q[i] = 0, cnt[i] = 0;
+    return newC;
+}
+
+void Lsolver::sampleEta() {
+    // the occupancy counted while mixing is biased by the start, so eta is
+    // only sampled from here on
+    bool parallel = etaReplicas > 1 and Cluster::getNumRanks() == 1;
+    if (parallel) sampleReplicas(etaReplicas);
+    else sampleBatches();
+}
+
+// batches of the DCP until the interval on their mean is within tol; eta
+// and etaError are their mean and its standard error
+void Lsolver::sampleBatches() {
+    int T = getNumThreads();
+    long maxSteps = (long) MAX_EPOCHS * epochLength;
+    work.fill(cnt, 0);
+    monitor.reset(n);
+    do {
+        pll_v2(batchLength);
+        monitor.add(cnt, batchLength, T);
+    } while ((monitor.getNumBatches() < MIN_BATCHES
+                or monitor.getRelativeHalfWidth() > tol)
+            and monitor.getNumSteps() < maxSteps);
+    metrics.steps += monitor.getNumSteps();
+
+    const auto& mean = monitor.getMean();
+    auto se = monitor.getStandardError();
+    eta.resize(n), etaError.resize(n);
+    work.forAll([&](int i) { eta[i] = mean[i], etaError[i] = se[i]; });
+}
+
+// R independent DCPs go on from Q at beta and sample to sqrt(R) times tol,
+// so that their mean, which becomes eta, is within tol. Their standard errors
+// are pooled into that of eta, and the queues go on from the first one.
+void Lsolver::sampleReplicas(int R) {
+    std::vector< std::unique_ptr<Lsolver> > dcp;
+    for (int r = 0; r < R; ++r) {
+        dcp.emplace_back(new Lsolver(*this, r, R));
+        Lsolver& s = *dcp.back();
+        s.beta = beta;
+        s.tol *= sqrt(R);
+        s.work.copy(s.Q, Q);
     }
+    replicaParts += R;
+    forReplicas(dcp, R, [](int, Lsolver& s) { s.sampleBatches(); });
 
-    // approximately getting back alpha ~= eta (I + P + P^2 ... P^k-1)/k
-    for (int k = 1; k < 1; ++k) {
-        std::vector<double> tmp(n, 0);
-        for (int i = 0; i < n; ++i) {
-            for (auto& j: adj[i]) {
-                tmp[j.first] += eta[i] * j.second;
+    eta.assign(n, 0), etaError.assign(n, 0);
+    for (auto& s: dcp) {
+        work.forAll([&](int i) {
+            eta[i] += s->eta[i]/R;
+            etaError[i] += s->etaError[i] * s->etaError[i];
+        });
+        takeMetrics(*s);
+    }
+    work.forAll([&](int i) { etaError[i] = sqrt(etaError[i])/R; });
+    work.copy(Q, dcp[0]->Q);
+}
+
+// f(r, replica) for the first m replicas of dcp at once, from a nested team
+// of up to getNumThreads(); the threads of replica r take the r-th block of
+// the cpus, and the thread running it goes back to its own after
+template <typename F>
+void Lsolver::forReplicas(std::vector< std::unique_ptr<Lsolver> >& dcp,
+        int m, F f) {
+    int T = getNumThreads();
+    const auto& cpus = Topology::get().getOrder(pinning == SPREAD);
+    auto cpuOf = [&](int p) { return cpus[p % cpus.size()]; };
+
+    int levels = omp_get_max_active_levels();
+    omp_set_max_active_levels(std::max(levels, 2));
+#pragma omp parallel for num_threads(std::min(m, T)) schedule(static, 1)
+    for (int r = 0; r < m; ++r) {
+        Lsolver& s = *dcp[r];
+        int tid = omp_get_thread_num();
+        if (pinning != NONE) {
+#pragma omp parallel num_threads(s.nthreads)
+            Topology::pin(cpuOf(r * s.nthreads + omp_get_thread_num()));
+        }
+        f(r, s);
+        if (pinning != NONE) Topology::pin(cpuOf(tid));
+    }
+    omp_set_max_active_levels(levels);
+}
+
+// adds the epochs and counts of replica s to the metrics, clearing its own
+void Lsolver::takeMetrics(Lsolver& s) {
+    metrics.epochs.insert(metrics.epochs.end(), s.metrics.epochs.begin(),
+            s.metrics.epochs.end());
+    metrics.steps += s.metrics.steps;
+    metrics.hops += s.metrics.hops;
+    metrics.sunk += s.metrics.sunk;
+    s.metrics = Metrics();
+}
+
+// Brackets beta between the largest admissible (lo) and the smallest
+// rejected (hi) candidate seen. The occupancy of the busiest slot grows about
+// linearly with beta, so the secant through the origin and lo predicts where
+// it meets the cap; when that overshoots hi the bracket is bisected instead.
+// Every candidate is warm started from the queues lo mixed to, scaled to its
+// own beta, so it only pays a short re-mixing instead of a cold start.
+void Lsolver::searchBeta() {
+    PhaseTimer timer(hook, "search", metrics.search);
+    eta.assign(n, 0);
+    work.fill(Q, 0), work.fill(cnt, 0), work.fill(work.savedQ, 0);
+
+    // generation probabilities beta J_u must stay below 1
+    double maxBeta = 1/max(J);
+
+    double lo = 0;
+    double hi = 0;
+    double loOccupancy = 0;
+    auto& warmQ = work.savedQ;
+
+    auto tryBeta = [&](double b) {
+        if (lo > 0) {
+            work.forAll([&](int i) { Q[i] = (int) (warmQ[i] * b/lo + 0.5); });
+        }
+        Q[sink] = 0;
+        beta = b;
+
+        int epochs0 = (int) metrics.epochs.size();
+        double C = mixDCP();
+        bool admissible = isAdmissible(C);
+        metrics.candidates.push_back({b,
+            (int) metrics.epochs.size() - epochs0, C, occupancy, admissible});
+
+        if (admissible) {
+            // Q is started from warmQ again by the next candidate
+            lo = b, loOccupancy = occupancy, warmQ.swap(Q);
+            metrics.C = C;
+        } else {
+            hi = b;
+        }
+        return admissible;
+    };
+
+    // Can start with any big value, but beta < beta* is below 1; in a batch
+    // the previous right-hand side gives a much closer guess
+    double b = std::min(betaHint > 0 ? betaHint : 0.05, maxBeta);
+    while (not tryBeta(b) and b >= MIN_BETA) {
+        b /= 2;
+    }
+
+    for (int step = 0; step < betaSteps and lo > 0 and lo < maxBeta
+            and loOccupancy < BETA_TOL * MAX_OCCUPANCY; ++step) {
+        b = loOccupancy > 0 ? lo * TARGET_OCCUPANCY/loOccupancy : 2*lo;
+        if (hi > 0 and b >= hi) {
+            b = sqrt(lo*hi);
+        }
+        tryBeta(std::min(b, maxBeta));
+    }
+
+    // eta is only sampled for the chosen beta, from the queues it mixed to;
+    // when nothing was admissible this is the smallest candidate
+    if (lo > 0) {
+        beta = lo, Q.swap(warmQ);
+    } else {
+        metrics.C = metrics.candidates.back().C;
+        ++metrics.fallbacks;
+    }
+}
+
+// The search of searchBeta() with R = betaReplicas candidates a round,
+// mixed at once by DCPs of their own that split the threads. Until one is
+// admissible a round tries R halvings in a row, the first around the start
+// of searchBeta(); from then on the secant through lo spreads them over the
+// occupancies the search stops at, or they split the bracket geometrically
+// once that overshoots hi, all warm started from the queues of lo. The
+// largest admissible candidate of a round becomes lo. The replicas draw from
+// streams of their own, so the candidates differ from those of searchBeta().
+void Lsolver::searchBetaParallel() {
+    PhaseTimer timer(hook, "search", metrics.search);
+    eta.assign(n, 0);
+    work.fill(Q, 0), work.fill(cnt, 0), work.fill(work.savedQ, 0);
+
+    double maxBeta = 1/max(J);
+    int R = betaReplicas;
+    std::vector< std::unique_ptr<Lsolver> > dcp;
+    for (int r = 0; r < R; ++r) {
+        dcp.emplace_back(new Lsolver(*this, r, R));
+    }
+    replicaParts += R;
+
+    double lo = 0;
+    double hi = 0;
+    double loOccupancy = 0;
+    auto& warmQ = work.savedQ;
+    std::vector<double> bs;
+
+    auto tryRound = [&]() {
+        int m = (int) bs.size();
+        std::vector<double> C(m);
+        forReplicas(dcp, m, [&](int r, Lsolver& s) {
+            // a rejected candidate of the first rounds goes on from its own
+            // queues, as in searchBeta()
+            if (lo > 0) {
+                double scale = bs[r]/lo;
+                s.work.forAll([&](int i) {
+                    s.Q[i] = (int) (warmQ[i] * scale + 0.5);
+                });
             }
+            s.Q[sink] = 0;
+            s.beta = bs[r];
+            C[r] = s.mixDCP();
+        });
+
+        int best = -1;
+        std::vector<bool> admissible(m);
+        for (int r = 0; r < m; ++r) {
+            Lsolver& s = *dcp[r];
+            admissible[r] = s.isAdmissible(C[r]);
+            metrics.candidates.push_back({bs[r], (int) s.metrics.epochs.size(),
+                C[r], s.occupancy, admissible[r]});
+            takeMetrics(s);
+
+            if (admissible[r] and (best < 0 or bs[r] > bs[best])) best = r;
         }
-        for (int i = 0; i < n; ++i) {
-            eta[i] = tmp[i] + eta0[i];
+
+        if (best >= 0 and bs[best] > lo) {
+            // the replica starts from warmQ again in the next round
+            lo = bs[best], loOccupancy = dcp[best]->occupancy;
+            warmQ.swap(dcp[best]->Q);
+            metrics.C = C[best];
+        }
+        for (int r = 0; r < m; ++r) {
+            if (not admissible[r] and bs[r] > lo) {
+                hi = hi > 0 ? std::min(hi, bs[r]) : bs[r];
+            }
+        }
+    };
+
+    // the first round straddles the start of searchBeta(), every further
+    // one goes on halving
+    double b = (betaHint > 0 ? betaHint : 0.05) * pow(2, (R - 1)/2);
+    b = std::min(b, maxBeta);
+    do {
+        bs.clear();
+        for (int r = 0; r < R; ++r, b /= 2) {
+            bs.push_back(b);
+        }
+        tryRound();
+    } while (lo == 0 and b >= MIN_BETA);
+
+    for (int step = 0; step < betaSteps and lo > 0 and lo < maxBeta
+            and loOccupancy < BETA_TOL * MAX_OCCUPANCY; ++step) {
+        // every candidate aims at an occupancy of its own in the window the
+        // search stops in, by the secant through lo; the same beta is only
+        // tried once
+        bs.clear();
+        for (int r = 0; r < R; ++r) {
+            double o = BETA_TOL * MAX_OCCUPANCY
+                * pow(1/BETA_TOL, (double) r/(R - 1));
+            b = loOccupancy > 0 ? lo * o/loOccupancy : lo * pow(2, r + 1);
+            bs.push_back(std::min(b, maxBeta));
+        }
+        bs.erase(std::unique(bs.begin(), bs.end()), bs.end());
+        if (hi > 0 and bs.back() >= hi) {
+            bs.clear();
+            for (int r = 1; r <= R; ++r) {
+                bs.push_back(lo * pow(hi/lo, (double) r/(R + 1)));
+            }
         }
+        tryRound();
     }
-    for (int i = 0; i < n; ++i) {
-        eta[i] /= 1;
+
+    // eta is sampled from the queues of lo, or of the smallest candidate
+    // when nothing was admissible
+    if (lo > 0) {
+        beta = lo, Q.swap(warmQ);
+    } else {
+        beta = bs.back();
+        work.copy(Q, dcp[bs.size() - 1]->Q);
+        metrics.C = metrics.candidates.back().C;
+        ++metrics.fallbacks;
     }
+}
 
-    return newC;
+// Re-mixes the DCP of the last solve from its queues at its beta, as after
+// updateEdge; false if that beta is no longer admissible, the search then
+// starting from it
+bool Lsolver::remix() {
+    PhaseTimer timer(hook, "search", metrics.search);
+    work.fill(cnt, 0);
+    Q[sink] = 0;
+
+    // the queues are about stationary already, so one epoch usually tells;
+    // the DCP is mixed as usual when its sink fraction is off
+    int epochs0 = (int) metrics.epochs.size();
+    double C = runEpoch(epochLength);
+    if (fabs(1 - C) >= EPS) {
+        C = mixDCP();
+    }
+    bool admissible = isAdmissible(C);
+    metrics.candidates.push_back({beta,
+        (int) metrics.epochs.size() - epochs0, C, occupancy, admissible});
+
+    if (admissible) {
+        metrics.C = C;
+    } else {
+        betaHint = beta;
+    }
+    return admissible;
 }
 
 void Lsolver::computeStationarityState() {
-    // Can start with any big value, but beta < beta* is below 1
-    beta = 0.1;
-    double C = 0;
+    bool warm = resume and sink == lastSink and Q.size() == (size_t) n;
+    resume = false;
+    if (not (warm and remix())) {
+        bool parallel = betaReplicas > 1 and Cluster::getNumRanks() == 1;
+        if (parallel) searchBetaParallel();
+        else searchBeta();
+    }
+    lastSink = sink;
 
-    eta.resize(n, 0), Q.resize(n, 0), cnt.resize(n, 0);
-    do {
-        beta /= 2;
-        C = estimateEta(C);
-    } while (C < 0.85 and beta >= 0.0001);
+    PhaseTimer timer(hook, "sample", metrics.sample);
+    sampleEta();
 }
 
 std::vector<double> Lsolver::computeX() {
-    std::vector<double> x(n);
-#pragma omp parallel for
-    for (int i = 0; i < n; ++i) {
+    const auto& d = g.getDegreeMatrix();
+
+    // every rank fills in its own nodes and the pieces are summed up
+    std::vector<double> x(n, 0);
+#pragma omp parallel for num_threads(getNumThreads())
+    for (int i = first; i < last; ++i) {
         x[i] = (-b_sink/beta) * (eta[i]/d[i]);
     }
+    Cluster::sum(x);
     return x;
+}
 
-    // centering for canonical solution
-    //auto avg_x = sum(x)/n;
-    //for (int i = 0; i < n; ++i) {
-    //    x[i] -= avg_x;
-    //}
+// the variance of every x[i] of computeX() through the standard error of
+// eta[i], for the nodes of this rank
+void Lsolver::addVariance(std::vector<double>& var) const {
+    const auto& d = g.getDegreeMatrix();
+    for (int i = first; i < last; ++i) {
+        double se = (b_sink/beta) * (etaError[i]/d[i]);
+        var[i] += se*se;
+    }
+}
+
+const int MAX_ITERATIONS = 100000;
+
+// Jacobi preconditioned conjugate gradient on Lx = b from the x of the walks,
+// until ||b - Lx|| <= refineTol ||b||. L is singular, but b sums to zero and
+// so lies in its range; the offset x picks up along the way is removed by the
+// caller. Every rank updates its own rows, and the search direction, which
+// the products read at all the neighbours, is summed over the ranks.
+int Lsolver::refine(std::vector<double>& x, const std::vector<double>& b) {
+    const auto& d = g.getDegreeMatrix();
+    const auto& offset = g.getOffsets();
+    const auto& target = g.getTargets();
+    const auto& weight = g.getWeights();
+    int T = getNumThreads();
+
+    auto laplacian = [&](const std::vector<double>& y,
+            std::vector<double>& out) {
+#pragma omp parallel for num_threads(T) schedule(dynamic, 1024)
+        for (int i = first; i < last; ++i) {
+            double s = d[i] * y[i];
+            for (long e = offset[i]; e < offset[i + 1]; ++e) {
+                s -= weight[e] * y[target[e]];
+            }
+            out[i] = s;
+        }
+    };
+
+    auto dot = [&](const std::vector<double>& u, const std::vector<double>& v) {
+        double s = 0;
+#pragma omp parallel for num_threads(T) reduction(+: s)
+        for (int i = first; i < last; ++i) {
+            s += u[i] * v[i];
+        }
+        return Cluster::sum(s);
+    };
+
+    std::vector<double> r(n, 0), z(n, 0), p(n, 0), q(n, 0);
+    laplacian(x, q);
+    for (int i = first; i < last; ++i) {
+        r[i] = b[i] - q[i];
+        p[i] = z[i] = r[i]/d[i];
+    }
+    Cluster::sum(p);
+
+    double rz = dot(r, z);
+    double bound = refineTol * refineTol * dot(b, b);
+
+    int it = 0;
+    for (; it < MAX_ITERATIONS and dot(r, r) > bound; ++it) {
+        laplacian(p, q);
+        double alpha = rz/dot(p, q);
+
+        double rz1 = 0;
+#pragma omp parallel for num_threads(T) reduction(+: rz1)
+        for (int i = first; i < last; ++i) {
+            x[i] += alpha * p[i];
+            r[i] -= alpha * q[i];
+            z[i] = r[i]/d[i];
+            rz1 += r[i] * z[i];
+        }
+        rz1 = Cluster::sum(rz1);
+
+        std::fill(p.begin(), p.begin() + first, 0);
+        std::fill(p.begin() + last, p.end(), 0);
+#pragma omp parallel for num_threads(T)
+        for (int i = first; i < last; ++i) {
+            p[i] = z[i] + rz1/rz * p[i];
+        }
+        Cluster::sum(p);
+        rz = rz1;
+    }
+
+    std::fill(x.begin(), x.begin() + first, 0);
+    std::fill(x.begin() + last, x.end(), 0);
+    Cluster::sum(x);
+    return it;
 }
@@ -1,105 +1,280 @@
+#include "io.h"
 #include "graph.h"
 #include "lsolver.h"
+#include "cluster.h"
 
 #include <cmath>
 #include <vector>
 #include <cassert>
-#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <algorithm>
+#include <memory>
 #include <numeric>
 #include <iostream>
-#include <functional>
 
-void in(const char *fname, Graph& g, std::vector<double>& b);
-void out(const char *fname, const std::vector<double>& x);
+#include <unistd.h>
+
+void in(const char *fname, Graph& g,
+        std::vector< std::vector<double> >& bs);
+
+bool parseSchedule(const char *s, Lsolver::Schedule& schedule) {
+    const char *names[] = {"static", "dynamic", "balanced"};
+    for (int i = 0; i < 3; ++i) {
+        if (strcmp(s, names[i]) == 0) {
+            schedule = (Lsolver::Schedule) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parsePinning(const char *s, Lsolver::Pinning& pinning) {
+    const char *names[] = {"none", "compact", "spread"};
+    for (int i = 0; i < 3; ++i) {
+        if (strcmp(s, names[i]) == 0) {
+            pinning = (Lsolver::Pinning) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseFormat(const char *s, OutputFormat& format) {
+    const char *names[] = {"text", "f64", "f32"};
+    for (int i = 0; i < 3; ++i) {
+        if (strcmp(s, names[i]) == 0) {
+            format = (OutputFormat) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void usage() {
+    std::cerr << "Usage:\n ./main [options] <input_filename> <output_filename>\n"
+              << " (an output_filename of - writes to stdout)\n"
+              << "Options:\n"
+              << " -t <threads>  number of threads (default: OMP_NUM_THREADS"
+              << " or all cores)\n"
+              << " -s <seed>     master seed of the random number generators\n"
+              << " -e <tol>      relative confidence interval on eta at which"
+              << " sampling stops\n"
+              << " -c <tol>      refine x by conjugate gradient to this relative"
+              << " residual\n"
+              << " -p <policy>   static, dynamic or balanced scheduling of the"
+              << " nodes\n"
+              << " -a <policy>   none, compact or spread pinning of the"
+              << " threads to the cores\n"
+              << " -n            copy the alias tables to every socket, with"
+              << " -a compact or spread\n"
+              << " -w <hops>     hops per time step, 1 to 64, or auto (0)"
+              << " (default: 64)\n"
+              << " -b <count>    beta candidates mixed at once by the search,"
+              << " splitting the threads (default: 1)\n"
+              << " -m <count>    independent DCPs averaged into eta, splitting"
+              << " the threads (default: 1)\n"
+              << " -f            one barrier per time step instead of two\n"
+              << " -o <format>   text (default, round-trip digits), f64 or f32"
+              << " raw binary output\n"
+              << " -k <file>     start from this checkpoint if it exists, and"
+              << " save the solver to it (resuming the last sink only)\n"
+              << " -v            print the metrics of the solve\n"
+              << " -r            renumber the vertices for locality (reverse"
+              << " Cuthill-McKee)\n";
+    exit(0);
+}
 
 int main(int argc, char **argv) {
-    if (argc != 3) {
-        std::cerr << "Usage:\n ./main <input_filename> <output_filename>\n";
-        exit(0);
+    Cluster::init(&argc, &argv);
+
+    int nthreads = 0;
+    uint64_t seed = Rng::DEFAULT_SEED;
+    double tol = 0;
+    double refineTol = 0;
+    bool reorder = false;
+    bool verbose = false;
+    bool fused = false;
+    bool replicas = false;
+    int walkLength = Lsolver::MAX_K;
+    int betaReplicas = 1;
+    int etaReplicas = 1;
+    const char *ckname = nullptr;
+    OutputFormat format = TEXT;
+    Lsolver::Schedule schedule = Lsolver::STATIC;
+    Lsolver::Pinning pinning = Lsolver::NONE;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:s:e:c:p:a:w:b:m:k:o:nfrv")) != -1) {
+        switch (opt) {
+        case 't':
+            nthreads = atoi(optarg);
+            break;
+        case 's':
+            seed = strtoull(optarg, nullptr, 10);
+            break;
+        case 'e':
+            tol = atof(optarg);
+            break;
+        case 'c':
+            refineTol = atof(optarg);
+            break;
+        case 'r':
+            reorder = true;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        case 'n':
+            replicas = true;
+            break;
+        case 'w':
+            walkLength = strcmp(optarg, "auto") == 0 ? Lsolver::AUTO_K
+                : atoi(optarg);
+            if (walkLength < 0 or walkLength > Lsolver::MAX_K) usage();
+            break;
+        case 'b':
+            betaReplicas = atoi(optarg);
+            if (betaReplicas < 1) usage();
+            break;
+        case 'm':
+            etaReplicas = atoi(optarg);
+            if (etaReplicas < 1) usage();
+            break;
+        case 'a':
+            if (not parsePinning(optarg, pinning)) usage();
+            break;
+        case 'f':
+            fused = true;
+            break;
+        case 'k':
+            ckname = optarg;
+            break;
+        case 'o':
+            if (not parseFormat(optarg, format)) usage();
+            break;
+        case 'p':
+            if (not parseSchedule(optarg, schedule)) usage();
+            break;
+        default:
+            usage();
+        }
+    }
+
+    if (argc - optind != 2) {
+        usage();
+    }
+    if (ckname and Cluster::getNumRanks() > 1) {
+        std::cerr << "-k needs a single process\n";
+        Cluster::finalize();
+        return 1;
     }
 
     Graph g;
-    std::vector<double> b;
-    char *ifname = argv[1];
+    std::vector< std::vector<double> > bs;
+    char *ifname = argv[optind];
+
+    in(ifname, g, bs);
 
-    in(ifname, g, b);
+    // a checkpoint of an earlier run stands in for preparing g
+    std::unique_ptr<Lsolver> prepared;
+    if (ckname and access(ckname, R_OK) == 0) {
+        prepared.reset(new Lsolver(ckname));
+        if (prepared->getNumVertex() != g.getNumVertex()
+                or prepared->getNumArcs() != g.getNumArcs()
+                or prepared->getGraphHash() != g.getHash()) {
+            std::cerr << ckname << ": saved for another graph\n";
+            exit(1);
+        }
+        // which renumbers it and starts the next solve afresh
+        if (reorder and not prepared->isReordered()) prepared->reorder();
+    } else {
+        prepared.reset(new Lsolver(std::move(g)));
+        if (reorder) prepared->reorder();
+    }
 
-    auto x = Lsolver(g, b).solve();
+    Lsolver& solver = *prepared;
+    solver.setNumThreads(nthreads);
+    solver.setSeed(seed);
+    if (tol > 0) solver.setTolerance(tol);
+    if (refineTol > 0) solver.setRefineTolerance(refineTol);
+    solver.setSchedule(schedule);
+    solver.setWalkLength(walkLength);
+    solver.setPinning(pinning);
+    solver.setReplicas(replicas);
+    solver.setFusedSteps(fused);
+    solver.setBetaReplicas(betaReplicas);
+    solver.setEtaReplicas(etaReplicas);
+    auto xs = solver.solveBatch(bs);
+    if (Cluster::getRank() == 0) {
+        const auto& metrics = solver.getMetrics();
+        if (verbose) metrics.print(std::cerr);
+        else metrics.printSummary(std::cerr);
+    }
+    if (ckname) {
+        solver.save(ckname);
+    }
 
-    char *ofname = argv[2];
-    out(ofname, x);
+    char *ofname = argv[optind + 1];
+    if (Cluster::getRank() == 0) {
+        writeSolutions(ofname, xs, format);
+    }
 
+    Cluster::finalize();
     return 0;
 }
 
 const double EPS = 1e-6;
 
+// reports the components instead of asserting, so that large inputs fail
+// fast with something to act on
 bool isConnected(const Graph& g) {
-    auto n = g.getNumVertex();
-    std::vector<bool> visited(n, false);
-
-    std::function<void(int)> dfs = [&](int u) {
-        visited[u] = true;
-        for (auto& neigh: g.getNeighbors(u)) {
-            auto v = neigh.first;
-            if (not visited[v]) {
-                dfs(v);
-            }
-        }
-    };
+    std::vector<int> label;
+    int ncomponents = g.getComponents(label);
+    if (ncomponents == 1) return true;
 
-    dfs(0);
-    for (int i = 0; i < n; ++i) {
-        if (not visited[i]) {
-            std::cerr << i << " is not reachable from 0\n";
-            return false;
+    std::map<int, int> size;
+    for (const auto& i: label) {
+        ++size[i];
+    }
+
+    const int MAX_REPORTED = 10;
+    std::cerr << "The graph has " << ncomponents << " components:\n";
+    int k = 0;
+    for (const auto& c: size) {
+        if (k++ == MAX_REPORTED) {
+            std::cerr << " ...\n";
+            break;
         }
+        std::cerr << " " << c.second << " vertices reachable from "
+                  << c.first + 1 << '\n';
     }
 
-    return true;
+    return false;
 }
 
+// the solver takes any b summing to zero; every negative entry is a sink
 void checkValidb(const std::vector<double>& b) {
-    auto b_sink = b.back();
-    assert(fabs(b_sink) > EPS);
+    assert(std::any_of(b.begin(), b.end(),
+                [](double i) { return i < -EPS; }));
 
     auto sum_b = std::accumulate(b.begin(), b.end(), 0.0);
     assert(fabs(sum_b) < EPS);
 }
 
-void in(const char *ifname, Graph& g, std::vector<double>& b) {
-    std::ifstream infile(ifname);
-
-    int n;
-    int m;
-    infile >> n >> m;
-
-    g.setNumVertex(n);
-    for (int i = 0; i < m; ++i) {
-        int u;
-        int v;
-        double w;
-
-        infile >> u >> v >> w;
-
-        assert(w > EPS);
-        assert(u != v);
-
-        g.addEdge(u - 1, v - 1, w);
-    }
-    assert(isConnected(g));
-
-    b.resize(n);
-    for (int i = 0; i < n; ++i) {
-        infile >> b[i];
+void in(const char *ifname, Graph& g,
+        std::vector< std::vector<double> >& bs) {
+    // every rank only reads the arcs of its own vertices, which leaves no
+    // rank with the whole graph to check
+    readInput(ifname, g, bs, Cluster::getRank(), Cluster::getNumRanks());
+    if (Cluster::getNumRanks() == 1 and not isConnected(g)) {
+        exit(1);
     }
-    checkValidb(b);
-}
 
-void out(const char *fname, const std::vector<double>& x) {
-    std::ofstream outfile(fname);
-    for (const auto& i: x) {
-        outfile << i << ' ';
+    assert(not bs.empty());
+    for (const auto& b: bs) {
+        assert((int) b.size() == g.getNumVertex());
+        checkValidb(b);
     }
-    outfile << '\n';
 }
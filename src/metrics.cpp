@@ -0,0 +1,52 @@
+#include "metrics.h"
+
+#include <algorithm>
+
+double Metrics::getImbalance() const {
+    double total = 0, most = 0;
+    for (auto t: busy) {
+        total += t, most = std::max(most, t);
+    }
+    return total > 0 ? most * busy.size()/total : 1;
+}
+
+void Metrics::printSummary(std::ostream& out) const {
+    out << "Time: " << total << '\n'
+        << "Steps: " << steps << '\n';
+    if (iterations > 0) {
+        out << "Iterations: " << iterations << '\n';
+    }
+}
+
+void Metrics::print(std::ostream& out) const {
+    out << "Time: " << total << '\n'
+        << " init: " << init << '\n'
+        << " search: " << search << '\n'
+        << " sample: " << sample << '\n'
+        << " computeX: " << computeX << '\n'
+        << " refine: " << refine << '\n';
+
+    out << "Candidates: " << candidates.size() << '\n';
+    for (const auto& c: candidates) {
+        out << " beta " << c.beta << ": " << c.epochs << " epochs, C " << c.C
+            << ", occupancy " << c.occupancy
+            << (c.admissible ? ", admitted" : ", rejected") << '\n';
+    }
+    if (fallbacks > 0) {
+        out << "Warning: no admissible beta in " << fallbacks
+            << " searches, eta sampled at the smallest candidate\n";
+    }
+
+    double epochTotal = 0;
+    for (auto t: epochs) epochTotal += t;
+    out << "Epochs: " << epochs.size() << " in " << epochTotal << '\n'
+        << "Steps: " << steps << '\n'
+        << "Hops: " << hops << '\n'
+        << "Sunk: " << sunk << '\n'
+        << "C: " << C << '\n'
+        << "Iterations: " << iterations << '\n';
+
+    out << "Imbalance: " << getImbalance() << " (busy";
+    for (auto t: busy) out << ' ' << t;
+    out << ")\n";
+}
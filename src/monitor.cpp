@@ -0,0 +1,48 @@
+#include "monitor.h"
+#include "cluster.h"
+
+#include <math.h>
+
+#include <limits>
+
+std::vector<double> ConvergenceMonitor::getStandardError() const {
+    std::vector<double> se(n, 0);
+    if (nbatches < 2) return se;
+    for (int i = 0; i < n; ++i) {
+        se[i] = sqrt(m2[i]/((double) (nbatches - 1) * nbatches));
+    }
+    return se;
+}
+
+void ConvergenceMonitor::add(Array<int>& cnt, int steps, int nthreads) {
+    ++nbatches;
+    nsteps += steps;
+
+    double var = 0;
+    double norm = 0;
+#pragma omp parallel for num_threads(nthreads) reduction(+: var, norm)
+    for (int i = 0; i < n; ++i) {
+        double x = (double) cnt[i]/steps;
+        cnt[i] = 0;
+
+        double delta = x - mean[i];
+        mean[i] += delta/nbatches;
+        m2[i] += delta*(x - mean[i]);
+
+        var += m2[i];
+        norm += mean[i]*mean[i];
+    }
+
+    // nodes of other ranks count as zero here
+    var = Cluster::sum(var);
+    norm = Cluster::sum(norm);
+
+    if (nbatches < 2 or norm == 0) {
+        halfWidth = std::numeric_limits<double>::infinity();
+        return;
+    }
+
+    // variance of the mean of nbatches batches, summed over the nodes
+    var /= (double) (nbatches - 1) * nbatches;
+    halfWidth = Z * sqrt(var/norm);
+}
@@ -0,0 +1,58 @@
+#include "reorder.h"
+
+#include <algorithm>
+
+// vertices in breadth first order from start, neighbours by increasing degree
+static void bfs(const Graph& g, int start, std::vector<char>& seen,
+        std::vector<int>& order) {
+    const auto& offset = g.getOffsets();
+    const auto& target = g.getTargets();
+
+    seen[start] = 1;
+    order.push_back(start);
+    for (size_t head = order.size() - 1; head < order.size(); ++head) {
+        int u = order[head];
+        size_t begin = order.size();
+        for (long e = offset[u]; e < offset[u + 1]; ++e) {
+            int v = target[e];
+            if (not seen[v]) {
+                seen[v] = 1;
+                order.push_back(v);
+            }
+        }
+        std::sort(order.begin() + begin, order.end(), [&](int a, int b) {
+            return g.getDegree(a) < g.getDegree(b);
+        });
+    }
+}
+
+std::vector<int> rcmOrder(const Graph& g) {
+    int n = g.getNumVertex();
+
+    std::vector<int> byDegree(n);
+    for (int u = 0; u < n; ++u) byDegree[u] = u;
+    std::stable_sort(byDegree.begin(), byDegree.end(), [&](int a, int b) {
+        return g.getDegree(a) < g.getDegree(b);
+    });
+
+    std::vector<char> seen(n, 0);
+    std::vector<int> order;
+    order.reserve(n);
+
+    for (int s: byDegree) {
+        if (seen[s]) continue;
+
+        // the last vertex reached from the one of least degree is a cheap
+        // pseudo-peripheral start
+        size_t begin = order.size();
+        bfs(g, s, seen, order);
+        int start = order.back();
+        for (size_t i = begin; i < order.size(); ++i) seen[order[i]] = 0;
+        order.resize(begin);
+
+        bfs(g, start, seen, order);
+        std::reverse(order.begin() + begin, order.end());
+    }
+
+    return order;
+}
@@ -1,27 +1,75 @@
 #include "sampler.h"
 
-Sampler::Sampler(const std::vector< std::pair<int, double> >& p) {
-    n = (int) p.size();
+#include <algorithm>
 
-    objects.resize(n);
-    std::vector<double> weights(n);
-    for (int i = 0; i < n; ++i) {
-        objects[i] = p[i].first;
-        weights[i] = p[i].second;
+#if defined(__AVX2__)
+// the undefined sources of the AVX-512 intrinsics of GCC 12 read as
+// uninitialized once inlined
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#endif
+
+template <typename Slots>
+AliasSampler<Slots>::AliasSampler(const Graph& g) {
+    bind(g);
+
+    slots.resize(g.getNumArcs());
+
+    int n = g.getNumVertex();
+#pragma omp parallel
+    {
+        // scratch space reused across the rows handled by this thread
+        std::vector<double> P;
+        std::vector<int> small;
+        std::vector<int> large;
+
+#pragma omp for schedule(dynamic, 64)
+        for (int u = 0; u < n; ++u) {
+            init(g, u, P, small, large);
+        }
     }
+}
+
+template <typename Slots>
+AliasSampler<Slots> AliasSampler<Slots>::replicate(const Graph& g) const {
+    AliasSampler r;
+    r.weight = weight;
+    r.deg = deg;
 
-    init(weights);
+    long m = g.getNumArcs();
+    r.ownOffset.assign(offset, offset + g.getNumVertex() + 1);
+    r.ownTarget.assign(target, target + m);
+    r.offset = r.ownOffset.data();
+    r.target = r.ownTarget.data();
+
+    r.slots = slots;
+    return r;
 }
 
-void Sampler::init(std::vector<double>& P) {
-    prob.resize(n);
-    alias.resize(n);
+template <typename Slots>
+void AliasSampler<Slots>::update(const Graph& g, int u) {
+    std::vector<double> P;
+    std::vector<int> small;
+    std::vector<int> large;
+    init(g, u, P, small, large);
+}
 
-    std::vector<int> small; small.reserve(n);
-    std::vector<int> large; large.reserve(n);
+template <typename Slots>
+void AliasSampler<Slots>::init(const Graph& g, int u,
+        std::vector<double>& P,
+        std::vector<int>& small,
+        std::vector<int>& large) {
+    long first = offset[u];
+    int n = g.getDegree(u);
+    double d = g.getDegreeMatrix()[u];
+
+    const auto& w = g.getWeights();
+
+    P.resize(n);
+    small.clear(), large.clear();
 
     for (int i = 0; i < n; ++i) {
-        P[i] *= n;
+        P[i] = w[first + i]/d * n;
         if (P[i] < 1) {
             small.push_back(i);
         } else {
@@ -33,8 +81,7 @@ void Sampler::init(std::vector<double>& P) {
         auto less = small.back(); small.pop_back();
         auto more = large.back(); large.pop_back();
 
-        prob[less] = P[less];
-        alias[less] = more;
+        slots.set(first + less, P[less], target[first + more]);
 
         P[more] -= (1 - P[less]);
 
@@ -45,6 +92,137 @@ void Sampler::init(std::vector<double>& P) {
         }
     }
 
-    for (auto &i: large) prob[i] = 1;
-    for (auto &i: small) prob[i] = 1;
+    for (auto &i: large) slots.set(first + i, 1, target[first + i]);
+    for (auto &i: small) slots.set(first + i, 1, target[first + i]);
 }
+
+// slot among the n of a row picked by the high half of w
+static inline int slotOf(uint64_t w, int n) {
+    return (int) (((w >> 32) * (uint64_t) n) >> 32);
+}
+
+void WideSlots::draw(const uint64_t *w, int m, int n, long first,
+        const int *target, int *out) const {
+    const double *p = prob.data() + first;
+    const int *t = target + first;
+    const int *a = alias.data() + first;
+
+    int i = 0;
+#if defined(__AVX512F__)
+    const __m512i vn = _mm512_set1_epi64(n);
+    for (; i + 8 <= m; i += 8) {
+        __m512i x = _mm512_loadu_si512(w + i);
+        __m512i col = _mm512_srli_epi64(
+                _mm512_mul_epu32(_mm512_srli_epi64(x, 32), vn), 32);
+        __m512d coin = _mm512_mul_pd(
+                _mm512_cvtepu32_pd(_mm512_cvtepi64_epi32(x)),
+                _mm512_set1_pd(0x1p-32));
+        __mmask8 keep = _mm512_cmp_pd_mask(coin,
+                _mm512_i64gather_pd(col, p, 8), _CMP_LT_OQ);
+
+        __m256i v = _mm512_i64gather_epi32(col, a, 4);
+        v = _mm512_mask_i64gather_epi32(v, keep, col, t, 4);
+        _mm256_storeu_si256((__m256i *) (out + i), v);
+    }
+#elif defined(__AVX2__)
+    const __m256i vn = _mm256_set1_epi64x(n);
+    const __m256i lows = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    for (; i + 4 <= m; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (w + i));
+        __m256i col = _mm256_srli_epi64(
+                _mm256_mul_epu32(_mm256_srli_epi64(x, 32), vn), 32);
+
+        // AVX2 converts signed ints only: the low halves are shifted down by
+        // 2^31, and back up by 1/2 once scaled
+        __m128i lo = _mm256_castsi256_si128(
+                _mm256_permutevar8x32_epi32(x, lows));
+        lo = _mm_xor_si128(lo, _mm_set1_epi32(INT32_MIN));
+        __m256d coin = _mm256_add_pd(
+                _mm256_mul_pd(_mm256_cvtepi32_pd(lo), _mm256_set1_pd(0x1p-32)),
+                _mm256_set1_pd(0.5));
+        __m256d keep = _mm256_cmp_pd(coin,
+                _mm256_i64gather_pd(p, col, 8), _CMP_LT_OQ);
+        __m128i mask = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(
+                    _mm256_castpd_si256(keep), lows));
+
+        __m128i v = _mm256_i64gather_epi32(a, col, 4);
+        v = _mm256_mask_i64gather_epi32(v, t, col, mask, 4);
+        _mm_storeu_si128((__m128i *) (out + i), v);
+    }
+#endif
+    for (; i < m; ++i) {
+        int c = slotOf(w[i], n);
+        out[i] = ((uint32_t) w[i] * 0x1p-32 < p[c]) ? t[c] : a[c];
+    }
+}
+
+void CompactSlots::draw(const uint64_t *w, int m, int n, long first,
+        const int *target, int *out) const {
+    const Slot *s = slot.data() + first;
+    const int *t = target + first;
+
+    // a slot is gathered as one 64-bit word, the cut in its low half and the
+    // alias in its high half
+    int i = 0;
+#if defined(__AVX512F__)
+    const __m512i vn = _mm512_set1_epi64(n);
+    const __m512i low = _mm512_set1_epi64(UINT32_MAX);
+    for (; i + 8 <= m; i += 8) {
+        __m512i x = _mm512_loadu_si512(w + i);
+        __m512i col = _mm512_srli_epi64(
+                _mm512_mul_epu32(_mm512_srli_epi64(x, 32), vn), 32);
+        __m512i sl = _mm512_i64gather_epi64(col, s, 8);
+        __mmask8 keep = _mm512_cmplt_epu64_mask(_mm512_and_si512(x, low),
+                _mm512_and_si512(sl, low));
+
+        __m256i v = _mm512_cvtepi64_epi32(_mm512_srli_epi64(sl, 32));
+        v = _mm512_mask_i64gather_epi32(v, keep, col, t, 4);
+        _mm256_storeu_si256((__m256i *) (out + i), v);
+    }
+#elif defined(__AVX2__)
+    const __m256i vn = _mm256_set1_epi64x(n);
+    const __m256i low = _mm256_set1_epi64x(UINT32_MAX);
+    const __m256i lows = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256i highs = _mm256_setr_epi32(1, 3, 5, 7, 0, 2, 4, 6);
+    for (; i + 4 <= m; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (w + i));
+        __m256i col = _mm256_srli_epi64(
+                _mm256_mul_epu32(_mm256_srli_epi64(x, 32), vn), 32);
+        __m256i sl = _mm256_i64gather_epi64((const long long *) s, col, 8);
+
+        // the halves are below 2^32, so the signed compare will do
+        __m256i keep = _mm256_cmpgt_epi64(_mm256_and_si256(sl, low),
+                _mm256_and_si256(x, low));
+        __m128i mask = _mm256_castsi256_si128(
+                _mm256_permutevar8x32_epi32(keep, lows));
+
+        __m128i v = _mm256_castsi256_si128(
+                _mm256_permutevar8x32_epi32(sl, highs));
+        v = _mm256_mask_i64gather_epi32(v, t, col, mask, 4);
+        _mm_storeu_si128((__m128i *) (out + i), v);
+    }
+#endif
+    for (; i < m; ++i) {
+        int c = slotOf(w[i], n);
+        out[i] = ((uint32_t) w[i] < s[c].cut) ? t[c] : s[c].alias;
+    }
+}
+
+template <typename Slots>
+void AliasSampler<Slots>::generate(int u, int count, int *out,
+        RngLanes& rng) const {
+    const int BATCH = 64;
+    alignas(64) uint64_t w[BATCH];
+
+    long first = offset[u];
+    int n = (int) (offset[u + 1] - first);
+    for (int done = 0; done < count; done += BATCH) {
+        int m = std::min(BATCH, count - done);
+        int L = RngLanes::LANES;
+        rng.fill(w, (m + L - 1)/L * L);
+        slots.draw(w, m, n, first, target, out + done);
+    }
+}
+
+template class AliasSampler<WideSlots>;
+template class AliasSampler<CompactSlots>;
@@ -0,0 +1,86 @@
+#include "topology.h"
+
+#include <sched.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <tuple>
+
+// value of a topology file of cpu, or -1
+static int readTopology(int cpu, const char *name) {
+    std::ifstream f("/sys/devices/system/cpu/cpu" + std::to_string(cpu)
+            + "/topology/" + name);
+    int x = -1;
+    if (not (f >> x)) return -1;
+    return x;
+}
+
+const Topology& Topology::get() {
+    static const Topology topology;
+    return topology;
+}
+
+Topology::Topology() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof set, &set) != 0) {
+        CPU_SET(0, &set);
+    }
+
+    // package, core and cpu of every cpu allowed
+    std::vector< std::tuple<int, int, int> > cpus;
+    std::vector<int> packages;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (not CPU_ISSET(cpu, &set)) continue;
+
+        int package = std::max(0, readTopology(cpu, "physical_package_id"));
+        auto it = std::find(packages.begin(), packages.end(), package);
+        int s = (int) (it - packages.begin());
+        if (it == packages.end()) packages.push_back(package);
+
+        if ((int) socket.size() <= cpu) socket.resize(cpu + 1, 0);
+        socket[cpu] = s;
+        cpus.emplace_back(s, readTopology(cpu, "core_id"), cpu);
+    }
+    nsockets = std::max(1, (int) packages.size());
+
+    std::sort(cpus.begin(), cpus.end());
+    for (const auto& c: cpus) {
+        compactOrder.push_back(std::get<2>(c));
+    }
+
+    // Spread takes the first hyperthread of every core before any second
+    // one and, within that, the next core of every socket in turn: sorted by
+    // the hyperthread of the cpu in its core, the position of the cpu among
+    // those of its socket with that hyperthread, and the socket.
+    std::vector< std::tuple<int, int, int, int> > keys;
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        int s, core, cpu;
+        std::tie(s, core, cpu) = cpus[i];
+        int ht = 0;
+        for (size_t j = 0; j < i; ++j) {
+            ht += std::get<0>(cpus[j]) == s and std::get<1>(cpus[j]) == core;
+        }
+        int position = 0;
+        for (const auto& k: keys) {
+            position += std::get<2>(k) == s and std::get<0>(k) == ht;
+        }
+        keys.emplace_back(ht, position, s, cpu);
+    }
+    std::sort(keys.begin(), keys.end());
+    for (const auto& k: keys) {
+        spreadOrder.push_back(std::get<3>(k));
+    }
+}
+
+int Topology::getSocket(int cpu) const {
+    return (0 <= cpu and cpu < (int) socket.size()) ? socket[cpu] : 0;
+}
+
+bool Topology::pin(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof set, &set) == 0;
+}
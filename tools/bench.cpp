@@ -0,0 +1,274 @@
+#include "graph.h"
+#include "lsolver.h"
+#include "sampler.h"
+#include "generators.h"
+
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include <unistd.h>
+
+// Sweeps the solver over synthetic graphs, threads, walk lengths and epoch
+// lengths and writes one CSV row per run: the phase timings of the solver,
+// its throughput, its relative error against a CG reference and the standard
+// error it reports itself, relative the same way. With -a it
+// compares the alias tables of the samplers instead.
+
+void usage() {
+    std::cerr << "Usage:\n ./bench [options]\n"
+              << "Options:\n"
+              << " -g <graphs>   any of dense,sparse,grid,powerlaw"
+              << " (default: all)\n"
+              << " -n <n>        vertices per graph (default: 2000)\n"
+              << " -t <list>     threads to sweep, e.g. 1,2,4 (default: 1)\n"
+              << " -k <list>     hops per time step to sweep, 0 picking it from"
+              << " the degrees (default: 64)\n"
+              << " -l <list>     epoch lengths to sweep (default: 5000)\n"
+              << " -p <list>     schedules to sweep, of static,dynamic,balanced"
+              << " (default: static)\n"
+              << " -f <list>     1 for fused time steps, e.g. 0,1 (default: 0)\n"
+              << " -b <list>     beta candidates mixed at once by the search"
+              << " (default: 1)\n"
+              << " -m <list>     independent DCPs averaged into eta"
+              << " (default: 1)\n"
+              << " -s <seed>     seed of the generators and the solver\n"
+              << " -e <tol>      relative confidence interval on eta\n"
+              << " -o <file>     CSV output (default: stdout)\n"
+              << " -a            time the walks on the double and compact alias"
+              << " tables instead\n";
+    exit(0);
+}
+
+template <typename T>
+std::vector<T> parseList(const char *s) {
+    std::vector<T> v;
+    std::stringstream in(s);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        std::stringstream(item) >> v.emplace_back();
+    }
+    return v;
+}
+
+Graph generate(const std::string& kind, int n, Rng& rng) {
+    if (kind == "dense") return randomGraph(n, n/10.0, rng);
+    if (kind == "sparse") return randomGraph(n, 3, rng);
+    if (kind == "grid") return gridGraph((int) sqrt(n), rng);
+    if (kind == "powerlaw") return powerLawGraph(n, 3, rng);
+
+    std::cerr << "unknown graph " << kind << '\n';
+    exit(1);
+}
+
+double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast< std::chrono::duration<double> >(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+// the checksum of the timed loops is stored here, so that they stay in
+static volatile long sampledSink;
+
+// Times K hops from every vertex on the tables of S, and draws of 64 packets
+// leaving every vertex together; adds up the vertices reached into check so
+// that nothing is optimised out.
+template <typename S>
+void timeSampler(const Graph& g, int K, uint64_t seed, double& walk,
+        double& batch, long& check) {
+    S sampler(g);
+    Rng rng(seed);
+    RngLanes lanes(seed);
+    int n = g.getNumVertex();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int u = 0; u < n; ++u) {
+        int j = u;
+        for (int k = 0; k < K; ++k) {
+            j = sampler.generate(j, rng);
+        }
+        check += j;
+    }
+    walk = seconds(start) * 1e9/((double) n * K);
+
+    const int COUNT = 64;
+    std::vector<int> out(COUNT);
+    start = std::chrono::steady_clock::now();
+    for (int u = 0; u < n; ++u) {
+        sampler.generate(u, COUNT, out.data(), lanes);
+        check += out[COUNT - 1];
+    }
+    batch = seconds(start) * 1e9/((double) n * COUNT);
+}
+
+void compareSamplers(const std::vector<std::string>& graphs, int n, int K,
+        uint64_t seed, std::ostream& out) {
+    out << "graph,n,arcs,sampler,table_bytes,ns_per_hop,ns_per_batched_draw\n";
+
+    long check = 0;
+    for (const auto& kind: graphs) {
+        Rng rng(seed);
+        Graph g = generate(kind, n, rng);
+
+        double walk[2], batch[2];
+        timeSampler<Sampler>(g, K, seed, walk[0], batch[0], check);
+        timeSampler<CompactSampler>(g, K, seed, walk[1], batch[1], check);
+
+        const char *names[] = {"double", "compact"};
+        long bytes[] = {Sampler::getBytesPerArc(),
+            CompactSampler::getBytesPerArc()};
+        for (int i = 0; i < 2; ++i) {
+            out << kind << ',' << g.getNumVertex() << ',' << g.getNumArcs()
+                << ',' << names[i] << ',' << bytes[i] * g.getNumArcs()
+                << ',' << walk[i] << ',' << batch[i] << '\n' << std::flush;
+        }
+    }
+    sampledSink = check;
+}
+
+// as compare.py: both solutions shifted to a minimum of 0, which for a
+// one-sink b is the value at the sink
+double relativeError(const std::vector<double>& x,
+        const std::vector<double>& ref) {
+    double x0 = *std::min_element(x.begin(), x.end());
+    double ref0 = *std::min_element(ref.begin(), ref.end());
+
+    double d = 0, r = 0;
+    for (size_t i = 0; i < x.size(); ++i) {
+        double e = (x[i] - x0) - (ref[i] - ref0);
+        d += e*e;
+        r += (ref[i] - ref0) * (ref[i] - ref0);
+    }
+    return sqrt(d/r);
+}
+
+// ||standard error|| relative to the reference as relativeError() shifts it
+double relativeStdError(const std::vector<double>& se,
+        const std::vector<double>& ref) {
+    double ref0 = *std::min_element(ref.begin(), ref.end());
+
+    double d = 0, r = 0;
+    for (size_t i = 0; i < se.size(); ++i) {
+        d += se[i]*se[i];
+        r += (ref[i] - ref0) * (ref[i] - ref0);
+    }
+    return sqrt(d/r);
+}
+
+int main(int argc, char **argv) {
+    auto graphs = parseList<std::string>("dense,sparse,grid,powerlaw");
+    int n = 2000;
+    std::vector<int> threads = {1};
+    std::vector<int> walkLengths = {Lsolver::MAX_K};
+    std::vector<int> epochLengths = {5000};
+    auto schedules = parseList<std::string>("static");
+    const std::vector<std::string> scheduleNames =
+        {"static", "dynamic", "balanced"};
+    std::vector<int> fusedSteps = {0};
+    std::vector<int> betaReplicas = {1};
+    std::vector<int> etaReplicas = {1};
+    uint64_t seed = Rng::DEFAULT_SEED;
+    double tol = 0;
+    const char *ofname = nullptr;
+    bool samplers = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "g:n:t:k:l:p:f:b:m:s:e:o:a")) != -1) {
+        switch (opt) {
+        case 'g': graphs = parseList<std::string>(optarg); break;
+        case 'n': n = atoi(optarg); break;
+        case 't': threads = parseList<int>(optarg); break;
+        case 'k': walkLengths = parseList<int>(optarg); break;
+        case 'l': epochLengths = parseList<int>(optarg); break;
+        case 'p': schedules = parseList<std::string>(optarg); break;
+        case 'f': fusedSteps = parseList<int>(optarg); break;
+        case 'b': betaReplicas = parseList<int>(optarg); break;
+        case 'm': etaReplicas = parseList<int>(optarg); break;
+        case 's': seed = strtoull(optarg, nullptr, 10); break;
+        case 'e': tol = atof(optarg); break;
+        case 'o': ofname = optarg; break;
+        case 'a': samplers = true; break;
+        default: usage();
+        }
+    }
+
+    std::ofstream outfile;
+    if (ofname) outfile.open(ofname);
+    std::ostream& out = ofname ? outfile : std::cout;
+
+    if (samplers) {
+        compareSamplers(graphs, n, walkLengths[0], seed, out);
+        return 0;
+    }
+
+    out << "graph,n,arcs,threads,K,epoch_length,schedule,fused,"
+        << "beta_replicas,eta_replicas,init,search,sample,epochs,"
+        << "epoch_mean,epoch_max,compute_x,total,candidates,steps,hops,"
+        << "steps_per_second,imbalance,beta,relerr,std_error\n";
+
+    for (const auto& kind: graphs) {
+        Rng rng(seed);
+        Graph g = generate(kind, n, rng);
+        auto b = oneSinkRhs(g.getNumVertex(), g.getNumVertex()/10, rng);
+
+        // reference: the walks refined by CG far below any sampling error
+        Lsolver reference(g, b);
+        reference.setRefineTolerance(1e-10);
+        auto xref = reference.solve();
+
+        for (int T: threads) for (int K: walkLengths) for (int L: epochLengths)
+        for (const auto& schedule: schedules) for (int fused: fusedSteps)
+        for (int R: betaReplicas) for (int M: etaReplicas) {
+            auto it = std::find(scheduleNames.begin(), scheduleNames.end(),
+                    schedule);
+            if (it == scheduleNames.end()) {
+                std::cerr << "unknown schedule " << schedule << '\n';
+                exit(1);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            Lsolver solver(g, b);
+            solver.setNumThreads(T);
+            solver.setSeed(seed);
+            solver.setWalkLength(K);
+            solver.setEpochLength(L);
+            solver.setSchedule(
+                    (Lsolver::Schedule) (it - scheduleNames.begin()));
+            solver.setFusedSteps(fused);
+            solver.setBetaReplicas(R);
+            solver.setEtaReplicas(M);
+            if (tol > 0) solver.setTolerance(tol);
+            auto x = solver.solve();
+            double total = seconds(start);
+
+            const auto& t = solver.getMetrics();
+            double epochTotal = 0, epochMax = 0;
+            for (auto e: t.epochs) {
+                epochTotal += e, epochMax = std::max(epochMax, e);
+            }
+            double epochMean = t.epochs.empty() ? 0
+                : epochTotal/t.epochs.size();
+
+            double walking = t.search + t.sample;
+            out << kind << ',' << g.getNumVertex() << ',' << g.getNumArcs()
+                << ',' << T << ',' << solver.getWalkLength() << ',' << L
+                << ',' << schedule << ',' << fused << ',' << R << ',' << M
+                << ',' << t.init << ',' << t.search << ',' << t.sample
+                << ',' << t.epochs.size() << ',' << epochMean
+                << ',' << epochMax << ',' << t.computeX << ',' << total
+                << ',' << t.candidates.size() << ',' << t.steps
+                << ',' << t.hops << ',' << t.steps/std::max(walking, 1e-9)
+                << ',' << t.getImbalance()
+                << ',' << solver.getBeta() << ',' << relativeError(x, xref)
+                << ',' << relativeStdError(solver.getStandardError(), xref)
+                << '\n' << std::flush;
+        }
+    }
+
+    return 0;
+}
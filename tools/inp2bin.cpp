@@ -0,0 +1,21 @@
+#include "io.h"
+#include "graph.h"
+
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+
+// One-time conversion of an .inp file to the binary CSR format of io.h
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        std::cerr << "Usage:\n ./inp2bin <input.inp> <output.bin>\n";
+        exit(0);
+    }
+
+    Graph g;
+    std::vector< std::vector<double> > bs;
+    readInput(argv[1], g, bs);
+    writeBinary(argv[2], g, bs);
+
+    return 0;
+}